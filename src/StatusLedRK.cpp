@@ -1,97 +1,294 @@
 #include "StatusLedRK.h"
+#include <math.h>
+
+// The statement is only compiled if performance counters are enabled
+#if STATUSLEDRK_ENABLE_STATS
+#define STATUSLEDRK_STATS(x) x
+#else
+#define STATUSLEDRK_STATS(x)
+#endif
+
+// Half cosine easing curve, (1 - cos(pi * x / 255)) / 2 scaled to 0 - 255
+static const uint8_t easeSineTable[256] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,   1,   2,   2,   2,
+      2,   3,   3,   3,   4,   4,   5,   5,   6,   6,   6,   7,   8,   8,   9,   9,
+     10,  10,  11,  12,  12,  13,  14,  14,  15,  16,  17,  17,  18,  19,  20,  21,
+     22,  23,  23,  24,  25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  37,
+     38,  39,  40,  41,  42,  43,  45,  46,  47,  48,  49,  51,  52,  53,  54,  56,
+     57,  58,  60,  61,  62,  64,  65,  66,  68,  69,  71,  72,  73,  75,  76,  78,
+     79,  81,  82,  84,  85,  87,  88,  90,  91,  93,  94,  96,  97,  99, 100, 102,
+    103, 105, 106, 108, 109, 111, 113, 114, 116, 117, 119, 120, 122, 124, 125, 127,
+    128, 130, 131, 133, 135, 136, 138, 139, 141, 142, 144, 146, 147, 149, 150, 152,
+    153, 155, 156, 158, 159, 161, 162, 164, 165, 167, 168, 170, 171, 173, 174, 176,
+    177, 179, 180, 182, 183, 184, 186, 187, 189, 190, 191, 193, 194, 195, 197, 198,
+    199, 201, 202, 203, 204, 206, 207, 208, 209, 210, 212, 213, 214, 215, 216, 217,
+    218, 220, 221, 222, 223, 224, 225, 226, 227, 228, 229, 230, 231, 232, 232, 233,
+    234, 235, 236, 237, 238, 238, 239, 240, 241, 241, 242, 243, 243, 244, 245, 245,
+    246, 246, 247, 247, 248, 249, 249, 249, 250, 250, 251, 251, 252, 252, 252, 253,
+    253, 253, 253, 254, 254, 254, 254, 254, 255, 255, 255, 255, 255, 255, 255, 255
+};
+
+static const StatusLedRK::Keyframe breatheKeyframes[] = {
+    { StatusLedRK::keyframeLevel(0), 1000, StatusLedRK::EASING_SINE },
+    { StatusLedRK::keyframeLevel(255), 1000, StatusLedRK::EASING_SINE }
+};
+const StatusLedRK::Pattern StatusLedRK::PATTERN_BREATHE = { breatheKeyframes, 2, true };
+
+static const StatusLedRK::Keyframe fadeInKeyframes[] = {
+    { StatusLedRK::keyframeLevel(0), 1000, StatusLedRK::EASING_LINEAR },
+    { StatusLedRK::keyframeLevel(255), 0, StatusLedRK::EASING_STEP }
+};
+const StatusLedRK::Pattern StatusLedRK::PATTERN_FADE_IN = { fadeInKeyframes, 2, false };
+
+static const StatusLedRK::Keyframe fadeOutKeyframes[] = {
+    { StatusLedRK::keyframeLevel(255), 1000, StatusLedRK::EASING_LINEAR },
+    { StatusLedRK::keyframeLevel(0), 0, StatusLedRK::EASING_STEP }
+};
+const StatusLedRK::Pattern StatusLedRK::PATTERN_FADE_OUT = { fadeOutKeyframes, 2, false };
+
+// Index of the first entry in a pool sorted by pixel whose pixel is >= n
+template<class T>
+static size_t lowerBoundPixel(const T *pool, size_t count, uint16_t n) {
+    size_t low = 0;
+    size_t high = count;
+
+    while(low < high) {
+        size_t mid = (low + high) / 2;
+        if (pool[mid].pixel < n) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Resolve a keyframe color that may be a level of the pixel color
+static uint32_t keyframeColor(uint32_t kfColor, uint32_t pixelColor) {
+    if ((kfColor & StatusLedRK::KEYFRAME_LEVEL_FLAG) == 0) {
+        return kfColor & 0xffffff;
+    }
+    uint32_t scale = (kfColor & 0xff) + 1;
+    return ((((pixelColor >> 16) & 0xff) * scale >> 8) << 16)
+        | ((((pixelColor >> 8) & 0xff) * scale >> 8) << 8)
+        | ((pixelColor & 0xff) * scale >> 8);
+}
+
+// Map a fade position 0 - 255 through an easing curve
+static uint8_t applyEasing(uint8_t easing, uint8_t pos) {
+    switch(easing) {
+        case StatusLedRK::EASING_SINE:
+            return easeSineTable[pos];
+
+        case StatusLedRK::EASING_IN:
+            return (uint8_t)(((uint16_t)pos * pos) >> 8);
+
+        case StatusLedRK::EASING_OUT:
+            return (uint8_t)(255 - (((uint16_t)(255 - pos) * (255 - pos)) >> 8));
+
+        default:
+            return pos;
+    }
+}
+
+// Blend two RGB colors. weight is 0 (all a) to 256 (all b).
+static uint32_t blendColor(uint32_t a, uint32_t b, uint32_t weight) {
+    uint32_t result = 0;
+    for(int shift = 0; shift <= 16; shift += 8) {
+        uint32_t ca = (a >> shift) & 0xff;
+        uint32_t cb = (b >> shift) & 0xff;
+        result |= (((ca * (256 - weight) + cb * weight) >> 8) << shift);
+    }
+    return result;
+}
+
+// FNV-1a hash, used to validate snapshots
+static uint32_t snapshotHash(uint32_t hash, const uint8_t *p, size_t len) {
+    for(size_t ii = 0; ii < len; ii++) {
+        hash = (hash ^ p[ii]) * 16777619;
+    }
+    return hash;
+}
+
+static uint32_t snapshotChecksum(const uint8_t *buf, size_t len) {
+    // Everything except the checksum itself, which is last in the header
+    size_t checksumOffset = offsetof(StatusLedRK::SnapshotHeader, checksum);
+    uint32_t hash = snapshotHash(2166136261, buf, checksumOffset);
+    return snapshotHash(hash, buf + sizeof(StatusLedRK::SnapshotHeader), len - sizeof(StatusLedRK::SnapshotHeader));
+}
 
 
 StatusLedRK::StatusLedRK(size_t numPixels) : numPixels(numPixels) {
 }
 
 StatusLedRK::~StatusLedRK() {
-    if (state) {
-        delete[] state;
+    stopSystemMirror();
+    stopThread();
+    if (mutex) {
+        os_mutex_recursive_destroy(mutex);
+    }
+
+    if (!ownsStorage) {
+        // Storage belongs to a subclass such as StatusLedRK_Static
+        return;
+    }
+    if (colors) {
+        delete[] colors;
+    }
+    if (styles) {
+        delete[] styles;
+    }
+    if (blinkBits) {
+        delete[] blinkBits;
+    }
+    if (overrideBits) {
+        delete[] overrideBits;
     }
     if (overrides) {
         delete[] overrides;
     }
+    if (patterns) {
+        delete[] patterns;
+    }
+    if (outputTable) {
+        delete[] outputTable;
+    }
+    if (pixelBrightness) {
+        delete[] pixelBrightness;
+    }
+    if (dirty) {
+        delete[] dirty;
+    }
+    if (heap) {
+        delete[] heap;
+    }
+    if (heapPos) {
+        delete[] heapPos;
+    }
 }
 
 void StatusLedRK::setup() {
-    state = new PixelState[numPixels];
-    overrides = new LedOverride[numPixels];
+    size_t numWords = (numPixels + 31) / 32;
 
-    for(size_t ii = 0; ii < numPixels; ii++) {
-        state[ii].color = COLOR_BLACK;
-        state[ii].style = STYLE_ON;
-        state[ii].lastTime = 0;
-        state[ii].blinkState = false;
+    if (!colors) {
+        colors = new uint8_t[numPixels * 3];
+        styles = new uint8_t[(numPixels + 3) / 4];
+        blinkBits = new uint32_t[numWords];
+        overrideBits = new uint32_t[numWords];
+        dirty = new uint32_t[numWords];
+        heapPos = new uint16_t[numPixels];
+        if (!colors || !styles || !blinkBits || !overrideBits || !dirty || !heapPos) {
+            Log.error("StatusLedRK out of memory for %u pixels", (unsigned) numPixels);
+
+            // Free what was allocated and continue with no pixels, so calls that set pixels are ignored
+            delete[] colors;
+            delete[] styles;
+            delete[] blinkBits;
+            delete[] overrideBits;
+            delete[] dirty;
+            delete[] heapPos;
+            colors = 0;
+            styles = 0;
+            blinkBits = 0;
+            overrideBits = 0;
+            dirty = 0;
+            heapPos = 0;
+            numPixels = 0;
+            return;
+        }
+    }
 
-        overrides[ii].timeMs = 0; // inactive
+    // overrides, patterns, and heap are allocated as needed 
+    overrideCount = 0;
+    patternCount = 0;
+    heapSize = 0;
+    blinkingCount = 0;
+
+    // All pixels start out black, STYLE_ON (0), and not overridden
+    memset(colors, 0, numPixels * 3);
+    memset(styles, 0, (numPixels + 3) / 4);
+    memset(blinkBits, 0, numWords * sizeof(uint32_t));
+    memset(overrideBits, 0, numWords * sizeof(uint32_t));
+
+    for(size_t ii = 0; ii < numPixels; ii++) {
+        heapPos[ii] = HEAP_POS_NONE;
     }
 
+    // The hardware state is unknown, so the first show() writes every pixel
+    markAllDirty();
+
     setup2();
 }
 
 
 void StatusLedRK::loop() {
-    bool doShow = false;
+    STATUSLEDRK_STATS(uint32_t startUs = micros());
 
-    if (loopCheckEnabled) {
-        // We have either blinking or overrides so we may need to update the NeoPixels
+    WITH_LOCK(*this) {
+        // One timestamp is used for every pixel in this frame
+        uint32_t now = clockMillis();
 
-        if (checkForOverrideChange()) {
-            // An override expired so we need to restore the original color
-            doShow = true;
-        }
-
-        for(size_t ii = 0; ii < numPixels; ii++) {
-            PixelState *pixelState;
+        bool changed = mirrorEnabled && applySystemMirror();
 
-            if (overrides[ii].timeMs > 0) {
-                pixelState = &overrides[ii].state;
-            }
-            else {
-                pixelState = &state[ii];
-            }
-            
-            if (pixelState->style == STYLE_BLINK_SLOW) {
-                if (millis() - pixelState->lastTime >= SLOW_BLINK_MS) {
-                    pixelState->lastTime = millis();
-                    pixelState->blinkState = !pixelState->blinkState;
-                    doShow = true;
-                }
-            }
-            else
-            if (pixelState->style == STYLE_BLINK_FAST) {
-                if (millis() - pixelState->lastTime >= FAST_BLINK_MS) {
-                    pixelState->lastTime = millis();
-                    pixelState->blinkState = !pixelState->blinkState;
-                    doShow = true;
-                }
-            }
+        // If we have either blinking or overrides we may need to update the pixels.
+        // Only the earliest deadline is checked unless something is due.
+        if (loopCheckEnabled && processDueEvents(now)) {
+            changed = true;
+        }
+        if (changed || frameDeferred) {
+            // Also shows changes made too soon after the last refresh
+            showFrame(now);
         }
-    }
 
-    if (doShow) {
-        show();
+#if STATUSLEDRK_ENABLE_STATS
+        uint32_t elapsedUs = micros() - startUs;
+        if (stats.loopCalls++ == 0 || elapsedUs < stats.loopMinUs) {
+            stats.loopMinUs = elapsedUs;
+        }
+        if (elapsedUs > stats.loopMaxUs) {
+            stats.loopMaxUs = elapsedUs;
+        }
+        stats.loopTotalUs += elapsedUs;
+#endif
     }
 }
 
 
 uint32_t StatusLedRK::getColorWithOverride(uint16_t n)  {
+    WITH_LOCK(*this) {
+        if (n >= numPixels) {
+            return COLOR_BLACK;
+        }
+        return resolveColor(n);
+    }
+    return COLOR_BLACK;
+}
 
-    PixelState *curState = &state[n];
+uint32_t StatusLedRK::resolveColor(uint16_t n) const {
 
-    if (overrides[n].timeMs != 0) {
+    if (getBit(overrideBits, n)) {
         // An override is in effect, use that state instead
-        curState = &overrides[n].state;
+        const PixelState *curState = &findOverride(n)->state;
+
+        if (curState->style == STYLE_ON || hardwareBlink || (blinkSync ? isSyncBlinkOn(curState->style) : curState->blinkState)) {
+            // On, or blinking and in the on part of blinking, use the specified color
+            return curState->color;
+        }
+        else {
+            // Blinking and in the off part of blinking, use off (black)
+            return COLOR_BLACK;
+        }
     }
 
-    if (curState->style == STYLE_ON) {
-        // Just on, use the specified color
-        return curState->color;
+    uint8_t style = getStateStyle(n);
+    if (style == STYLE_PATTERN) {
+        // Computed when the frame was due
+        return findPattern(n)->frameColor;
     }
-    else
-    if (curState->blinkState) {
-        // Blinking and in the on part of blinking, use the specified color
-        return curState->color;
+    if (style == STYLE_ON || hardwareBlink || (blinkSync ? isSyncBlinkOn(style) : getBit(blinkBits, n))) {
+        // On, or blinking and in the on part of blinking, use the specified color
+        return getStateColor(n);
     }
     else {
         // Blinking and in the off part of blinking, use off (black)
@@ -104,106 +301,1974 @@ void StatusLedRK::setColor(uint16_t n, uint32_t color, bool showNow) {
 }
 
 void StatusLedRK::setColorStyle(uint16_t n, uint32_t color, uint8_t style, bool showNow) {
-    state[n].color = color;
-    state[n].style = style;
+    if (style == STYLE_PATTERN) {
+        // Patterns require setColorPattern()
+        style = STYLE_ON;
+    }
+
+    WITH_LOCK(*this) {
+        if (n >= numPixels) {
+            return;
+        }
+        applyColorStyle(n, color, style, 0);
+
+        if (showNow) {
+            requestShow();
+        }
 
-    if (overrides[n].timeMs > 0) {
-        // There is an override
-        if (overrides[n].clearOnChange) {
-            // clearOnChange is set, and we just changed the underlying color, so clear the override
-            overrides[n].timeMs = 0;
+        if (updateDepth == 0) {
+            updateLoopCheckEnabled();
+            wakeThread();
         }
     }
+}
 
-    if (showNow) {
-        show();
+void StatusLedRK::setColorPattern(uint16_t n, uint32_t color, const Pattern *pattern, bool showNow) {
+    WITH_LOCK(*this) {
+        if (n >= numPixels) {
+            return;
+        }
+        applyColorStyle(n, color, pattern ? STYLE_PATTERN : STYLE_ON, pattern);
+
+        if (showNow) {
+            requestShow();
+        }
+
+        if (updateDepth == 0) {
+            updateLoopCheckEnabled();
+            wakeThread();
+        }
     }
+}
 
-    updateLoopCheckEnabled();
+void StatusLedRK::applyColorStyle(uint16_t n, uint32_t color, uint8_t style, const Pattern *pattern, bool clearOverrides) {
+    bool reschedule = false;
+    uint32_t now = 0;
+    uint32_t baseLastTime = 0;
+    uint8_t oldStyle = getStateStyle(n);
+
+    if (style > STYLE_PATTERN || (style == STYLE_PATTERN && !pattern)) {
+        // Only 2 bits are stored, and blinkingCount depends on the style being one of these
+        style = STYLE_ON;
+    }
+    PatternState *ps = (oldStyle == STYLE_PATTERN) ? findPattern(n) : 0;
+
+    if (oldStyle != style || (ps && ps->pattern != pattern)) {
+        // Capture the blink timing before the style (and therefore the blink period) changes
+        now = clockMillis();
+        baseLastTime = getBaseLastTime(n, now);
+
+        if (style == STYLE_PATTERN) {
+            if (!ps) {
+                ps = insertPattern(n);
+                if (!ps) {
+                    // Out of memory, so show the color solid instead
+                    style = STYLE_ON;
+                }
+            }
+            if (ps) {
+                ps->pattern = pattern;
+                ps->startMillis = now;
+            }
+        }
+        else
+        if (ps) {
+            removePattern(ps);
+            ps = 0;
+        }
+
+        if (oldStyle == STYLE_ON && style != STYLE_ON) {
+            blinkingCount++;
+        }
+        else
+        if (oldStyle != STYLE_ON && style == STYLE_ON) {
+            blinkingCount--;
+        }
+        setStateStyle(n, style);
+        markDirty(n);
+        reschedule = true;
+
+        if (!isBlinkStyle(oldStyle)) {
+            // Was not blinking, so the blink starts now, from the off state like an override
+            baseLastTime = getBlinkStartTime(style, now);
+            clearBit(blinkBits, n);
+        }
+    }
+    bool colorChanged = (getStateColor(n) != (color & 0xffffff));
+    if (colorChanged) {
+        setStateColor(n, color);
+        markDirty(n);
+    }
+    if (ps && (reschedule || colorChanged)) {
+        // Keyframes can depend on the pixel color, so the current frame is recomputed
+        if (!reschedule) {
+            now = clockMillis();
+        }
+        updatePatternFrame(ps, now);
+    }
+
+    if (getBit(overrideBits, n)) {
+        // There is an override. Layers with clearOnChange set are removed because we just 
+        // changed the underlying color.
+        if (!reschedule) {
+            now = clockMillis();
+        }
+        uint32_t overrideBaseLastTime = findOverride(n)->baseLastTime;
+        bool topRemoved = clearOverrides && removeOverrideLayers(n, now, true);
+
+        if (!getBit(overrideBits, n)) {
+            // All layers were removed
+            baseLastTime = overrideBaseLastTime;
+            markDirty(n);
+            reschedule = true;
+        }
+        else {
+            // The override still determines the deadline; the base blink timing is restored when it ends
+            if (reschedule) {
+                setOverrideBaseLastTime(n, baseLastTime);
+            }
+            if (topRemoved) {
+                markDirty(n);
+                schedulePixel(n, now, 0);
+            }
+            reschedule = false;
+        }
+    }
+
+    if (reschedule) {
+        schedulePixel(n, now, baseLastTime);
+    }
 }
 
+bool StatusLedRK::evaluatePattern(const PatternState *ps, uint32_t now, uint32_t &color, uint32_t &nextMillis) const {
+    const Pattern *pattern = ps->pattern;
+    const Keyframe *keyframes = pattern->keyframes;
+    uint32_t pixelColor = getStateColor(ps->pixel);
 
-void StatusLedRK::setOverrideStyle(uint16_t n, uint32_t color, uint8_t style, unsigned long howLong, bool clearOnChange) {
-    overrides[n].startMillis = millis();
-    overrides[n].timeMs = howLong;
-    overrides[n].state.color = color;
-    overrides[n].state.style = style;
-    overrides[n].state.lastTime = 0;
-    overrides[n].state.blinkState = false;
-    overrides[n].clearOnChange = clearOnChange;
+    if (pattern->count == 0) {
+        color = COLOR_BLACK;
+        return false;
+    }
 
-    updateLoopCheckEnabled();
+    // A pattern that does not repeat has no transition after the last keyframe
+    size_t numSegments = pattern->repeat ? pattern->count : (pattern->count - 1);
+    uint32_t totalMs = 0;
+    for(size_t ii = 0; ii < numSegments; ii++) {
+        totalMs += keyframes[ii].durationMs;
+    }
 
-    show();
+    uint32_t elapsed = now - ps->startMillis;
+    if (totalMs == 0 || (!pattern->repeat && elapsed >= totalMs)) {
+        // Finished, or nothing to animate, so hold the last keyframe
+        color = keyframeColor(keyframes[pattern->repeat ? 0 : (pattern->count - 1)].color, pixelColor);
+        return false;
+    }
+    if (pattern->repeat) {
+        elapsed %= totalMs;
+    }
 
+    // Find the transition the pattern is in. Keyframes with a duration of 0 are skipped.
+    size_t index = 0;
+    while(elapsed >= keyframes[index].durationMs) {
+        elapsed -= keyframes[index].durationMs;
+        index++;
+    }
+    const Keyframe *from = &keyframes[index];
+    uint32_t remaining = from->durationMs - elapsed;
+
+    if (from->easing == EASING_STEP) {
+        // Held until the next keyframe
+        color = keyframeColor(from->color, pixelColor);
+        nextMillis = now + remaining;
+        return true;
+    }
+
+    const Keyframe *to = &keyframes[(index + 1) % pattern->count];
+    uint8_t pos = applyEasing(from->easing, (uint8_t)((elapsed << 8) / from->durationMs));
+    color = blendColor(keyframeColor(from->color, pixelColor), keyframeColor(to->color, pixelColor), pos + (pos >> 7));
+
+    // Update at the frame rate, but exactly at the end of the transition
+    nextMillis = now + ((remaining < patternFrameMs) ? remaining : patternFrameMs);
+    return true;
 }
 
-bool StatusLedRK::checkForOverrideChange() {
-    bool overrideChange = false;
+bool StatusLedRK::updatePatternFrame(PatternState *ps, uint32_t now) {
+    uint32_t color = COLOR_BLACK;
 
-    for(size_t ii = 0; ii < numPixels; ii++) {
-        if (overrides[ii].timeMs > 0) {
-            // Check to see if the override has expired
-            if (millis() - overrides[ii].startMillis >= overrides[ii].timeMs) {
-                // Yes, expired
-                overrides[ii].timeMs = 0;
-                overrideChange = true;
-            }
+    ps->running = evaluatePattern(ps, now, color, ps->nextMillis);
+    if (color == ps->frameColor) {
+        // Same as the last frame, so nothing to write
+        return false;
+    }
+    ps->frameColor = color;
+    markDirty(ps->pixel);
+    return true;
+}
+
+void StatusLedRK::setOverrideStyle(uint16_t n, uint32_t color, uint8_t style, unsigned long howLong, bool clearOnChange, uint8_t priority) {
+    WITH_LOCK(*this) {
+        if (n >= numPixels) {
+            return;
+        }
+        applyOverride(n, color, style, howLong, clearOnChange, priority, clockMillis());
+
+        if (updateDepth == 0) {
+            updateLoopCheckEnabled();
+            wakeThread();
         }
+
+        requestShow();
+    }
+}
+
+void StatusLedRK::setStatus(uint16_t n, uint16_t statusId, bool showNow) {
+    if (statusId >= statusCount) {
+        return;
     }
+    const StatusDefinition *def = &statusTable[statusId];
 
-    return overrideChange;
+    if (def->howLong != 0) {
+        setOverrideStyle(n, def->color, def->style, def->howLong, def->clearOnChange, def->priority);
+    }
+    else
+    if (def->style == STYLE_PATTERN) {
+        setColorPattern(n, def->color, def->pattern, showNow);
+    }
+    else {
+        setColorStyle(n, def->color, def->style, showNow);
+    }
 }
 
-void StatusLedRK::updateLoopCheckEnabled() {
-    loopCheckEnabled = false;
+const char *StatusLedRK::getStatusName(uint16_t statusId) const {
+    if (statusId >= statusCount || !statusTable[statusId].name) {
+        return "";
+    }
+    return statusTable[statusId].name;
+}
 
-    for(size_t ii = 0; ii < numPixels; ii++) {
-        if (overrides[ii].timeMs > 0) {
-            // There is an override, loop check is required
-            loopCheckEnabled = true;
+void StatusLedRK::fill(uint32_t color, uint8_t style, bool showNow) {
+    setRange(0, (uint16_t) numPixels, color, style, showNow);
+}
+
+void StatusLedRK::setRange(uint16_t first, uint16_t count, uint32_t color, uint8_t style, bool showNow) {
+    WITH_LOCK(*this) {
+        if (first >= numPixels) {
+            return;
         }
-        else
-        if (state[ii].style != STYLE_ON) {
-            // Blinking is enabled, so a loop check is required
-            loopCheckEnabled = true;
+        if (count > numPixels - first) {
+            count = (uint16_t)(numPixels - first);
+        }
+
+        beginUpdate();
+        for(uint16_t ii = 0; ii < count; ii++) {
+            setColorStyle(first + ii, color, style, false);
+        }
+        if (showNow) {
+            showPending = true;
         }
+        commit();
     }
 }
 
+void StatusLedRK::setColors(uint16_t first, const uint32_t *colorsArray, size_t count, uint8_t style, bool showNow) {
+    WITH_LOCK(*this) {
+        if (first >= numPixels) {
+            return;
+        }
+        if (count > numPixels - first) {
+            count = numPixels - first;
+        }
 
-StatusLedRK_RGB::StatusLedRK_RGB(size_t numPixels, const LedPins *pinsArray, bool isCommonAnode) : StatusLedRK(numPixels), pinsArray(pinsArray), isCommonAnode(isCommonAnode) {
+        beginUpdate();
+        for(size_t ii = 0; ii < count; ii++) {
+            setColorStyle((uint16_t)(first + ii), colorsArray[ii], style, false);
+        }
+        if (showNow) {
+            showPending = true;
+        }
+        commit();
+    }
 }
 
-StatusLedRK_RGB::~StatusLedRK_RGB() {
+void StatusLedRK::setOverrideRange(uint16_t first, uint16_t count, uint32_t color, uint8_t style, unsigned long howLong, bool clearOnChange, uint8_t priority) {
+    WITH_LOCK(*this) {
+        if (first >= numPixels) {
+            return;
+        }
+        if (count > numPixels - first) {
+            count = (uint16_t)(numPixels - first);
+        }
+
+        // All pixels in the range share the same start time so they expire together
+        uint32_t now = clockMillis();
+
+        beginUpdate();
+        for(uint16_t ii = 0; ii < count; ii++) {
+            applyOverride(first + ii, color, style, howLong, clearOnChange, priority, now);
+        }
+        showPending = true;
+        commit();
+    }
 }
 
-void StatusLedRK_RGB::setup2() {
+void StatusLedRK::beginUpdate() {
+    // The lock is held until the matching commit(). The mutex may be created by startThread() 
+    // during the update, so only the calls made after that lock it.
+    if (mutex) {
+        lock();
+        updateLockCount++;
+    }
+    updateDepth++;
+}
 
-    for(size_t ii = 0; ii < numPixels; ii++) {
-        pinMode(pinsArray[ii].rPin, OUTPUT);
-        pinMode(pinsArray[ii].gPin, OUTPUT);
-        pinMode(pinsArray[ii].bPin, OUTPUT);
+void StatusLedRK::commit() {
+    if (updateDepth == 0) {
+        // Not in a transaction
+        return;
+    }
+    if (--updateDepth == 0) {
+        updateLoopCheckEnabled();
+
+        if (showPending) {
+            showPending = false;
+            requestShow();
+        }
+        wakeThread();
+    }
+    if (updateLockCount > 0) {
+        // The innermost beginUpdate() calls are the ones that locked
+        updateLockCount--;
+        unlock();
+    }
+}
+
+void StatusLedRK::requestShow() {
+    if (updateDepth > 0) {
+        // Deferred until commit()
+        showPending = true;
+    }
+    else
+    if (frameLimitMs == 0) {
+        show();
+    }
+    else {
+        showFrame(clockMillis());
+    }
+}
+
+void StatusLedRK::showFrame(uint32_t now) {
+    if (!anyDirty) {
+        // Nothing to show, possibly because show() was called directly
+        frameDeferred = false;
+        return;
+    }
+    if (now - lastShowMillis < frameLimitMs) {
+        // Too soon after the last refresh, shown from loop() when the interval ends
+        if (!frameDeferred) {
+            frameDeferred = true;
+            STATUSLEDRK_STATS(stats.showsDeferred++);
+        }
+        return;
+    }
+    show();
+}
+
+void StatusLedRK::applyOverride(uint16_t n, uint32_t color, uint8_t style, unsigned long howLong, bool clearOnChange, uint8_t priority, uint32_t now) {
+    if (style > STYLE_BLINK_FAST) {
+        // Overrides are solid or blinking, never a pattern
+        style = STYLE_ON;
+    }
+
+    LedOverride *ov = 0;
+    if (getBit(overrideBits, n)) {
+        ov = findOverrideLayer(n, priority);
+    }
+
+    if (howLong == 0) {
+        // A zero duration removes an existing override layer
+        if (ov) {
+            bool wasTop = (ov == findOverride(n));
+            uint32_t baseLastTime = ov->baseLastTime;
+            removeOverride(ov);
+            if (wasTop && getBit(overrideBits, n)) {
+                // The next layer down is now shown, and it starts blinking again
+                ov = findOverride(n);
+                ov->state.lastTime = getBlinkStartTime(ov->state.style, now);
+                ov->state.blinkState = false;
+            }
+            schedulePixel(n, now, baseLastTime);
+        }
+    }
+    else {
+        if (!ov) {
+            uint32_t baseLastTime = getBaseLastTime(n, now);
+            ov = insertOverride(n, priority);
+            if (ov) {
+                ov->baseLastTime = baseLastTime;
+            }
+        }
+        if (ov) {
+            ov->startMillis = now;
+            ov->timeMs = howLong;
+            ov->state.color = color;
+            ov->state.style = style;
+            ov->state.lastTime = getBlinkStartTime(style, now);
+            ov->state.blinkState = false;
+            ov->clearOnChange = clearOnChange;
+            schedulePixel(n, now, 0);
+        }
+    }
+    markDirty(n);
+}
+
+bool StatusLedRK::checkForOverrideChange() {
+    return processDueEvents(clockMillis());
+}
+
+bool StatusLedRK::getNextEventMillis(uint32_t &when) {
+    WITH_LOCK(*this) {
+        return getNextDeadline(when);
+    }
+    return false;
+}
+
+unsigned long StatusLedRK::getMillisUntilNextEvent() {
+    WITH_LOCK(*this) {
+        uint32_t when;
+        if (!getNextDeadline(when)) {
+            return NO_EVENT;
+        }
+        uint32_t now = clockMillis();
+        return isBefore(now, when) ? (when - now) : 0;
+    }
+    return NO_EVENT;
+}
+
+void StatusLedRK::resync() {
+    WITH_LOCK(*this) {
+        uint32_t now = clockMillis();
+
+        bool changed = loopCheckEnabled && processDueEvents(now, true);
+        if (changed || frameDeferred) {
+            showFrame(now);
+        }
+    }
+    wakeThread();
+}
+
+bool StatusLedRK::advanceBlink(uint32_t &lastTime, unsigned long blinkMs, uint32_t now, bool catchUp) {
+    uint32_t elapsed = now - lastTime;
+    if (elapsed < blinkMs) {
+        return false;
+    }
+    if (!catchUp) {
+        lastTime = now;
+        return true;
     }
 
+    // Every missed change at once, so the phase is the same as if none were missed
+    uint32_t changes = elapsed / blinkMs;
+    lastTime += changes * blinkMs;
+    return (changes & 1) != 0;
 }
 
+bool StatusLedRK::processDueEvents(uint32_t now, bool catchUp) {
+    bool changed = false;
+
+    if (blinkSync && !hardwareBlink && (!isBefore(now, nextSlowToggle) || !isBefore(now, nextFastToggle))) {
+        // A blink phase boundary passed; only the pixels using that blink style change
+        bool oldSlowOn = syncSlowOn;
+        bool oldFastOn = syncFastOn;
 
-void StatusLedRK_RGB::show()  {
-    for(uint16_t ii = 0; ii < numPixels; ii++) {
-        uint32_t color = getColorWithOverride(ii);
-        uint8_t red = (uint8_t) (color >> 16);
-        uint8_t green = (uint8_t) (color >> 8);
-        uint8_t blue = (uint8_t) color;
+        updateSyncPhase(now);
 
-        if (isCommonAnode) {
-            red = 255 - red;
-            green = 255 - green;
-            blue = 255 - blue;
+        if (syncSlowOn != oldSlowOn) {
+            markStyleDirty(STYLE_BLINK_SLOW);
+            changed = true;
         }
+        if (syncFastOn != oldFastOn) {
+            markStyleDirty(STYLE_BLINK_FAST);
+            changed = true;
+        }
+    }
+
+    while(heapSize > 0 && !isBefore(now, heap[0].when)) {
+        uint16_t n = heap[0].pixel;
+        uint32_t baseLastTime;
+
+        if (getBit(overrideBits, n)) {
+            // Remove the layers whose time has run out. The top layer is only recomputed if one was removed.
+            baseLastTime = findOverride(n)->baseLastTime;
+            if (removeOverrideLayers(n, now, false)) {
+                markDirty(n);
+                changed = true;
+            }
+
+            if (getBit(overrideBits, n)) {
+                // Still overridden, so the blink of the top layer may be due
+                LedOverride *ov = findOverride(n);
+                if (hasBlinkDeadlines() && ov->state.style != STYLE_ON && advanceBlink(ov->state.lastTime, getBlinkMs(ov->state.style), now, catchUp)) {
+                    ov->state.blinkState = !ov->state.blinkState;
+                    STATUSLEDRK_STATS(stats.blinkToggles++);
+                    markDirty(n);
+                    changed = true;
+                }
+                schedulePixel(n, now, 0);
+                continue;
+            }
+
+            // All layers expired
+            updateLoopCheckEnabled();
+        }
+        else {
+            baseLastTime = getBaseLastTime(n, now);
+        }
+
+        uint8_t style = getStateStyle(n);
+        if (style == STYLE_PATTERN) {
+            // The next frame of the pattern is due
+            if (updatePatternFrame(findPattern(n), now)) {
+                STATUSLEDRK_STATS(stats.patternFrames++);
+                changed = true;
+            }
+        }
+        else
+        if (isBlinkStyle(style) && hasBlinkDeadlines()) {
+            if (advanceBlink(baseLastTime, getBlinkMs(style), now, catchUp)) {
+                flipBit(blinkBits, n);
+                STATUSLEDRK_STATS(stats.blinkToggles++);
+                markDirty(n);
+                changed = true;
+            }
+        }
+
+        // Nothing for this pixel is due now, so this always moves it later in the heap (or removes it)
+        schedulePixel(n, now, baseLastTime);
+    }
+
+    return changed;
+}
+
+uint32_t StatusLedRK::getBaseLastTime(uint16_t n, uint32_t now) const {
+    uint8_t style = getStateStyle(n);
+
+    if (getBit(overrideBits, n)) {
+        // Saved when the override started
+        return findOverride(n)->baseLastTime;
+    }
+    if (isBlinkStyle(style) && heapPos[n] != HEAP_POS_NONE) {
+        // A blinking pixel without an override is scheduled for its next toggle
+        return heap[heapPos[n]].when - getBlinkMs(style);
+    }
+
+    // Not blinking, so the next blink toggle will be immediately
+    return getBlinkStartTime(style, now);
+}
+
+void StatusLedRK::schedulePixel(uint16_t n, uint32_t now, uint32_t baseLastTime) {
+    bool hasDeadline = false;
+    uint32_t when = 0;
+    uint8_t style = getStateStyle(n);
+    uint32_t lastTime = baseLastTime;
 
-        analogWrite(pinsArray[ii].rPin, red);
-        analogWrite(pinsArray[ii].gPin, green);
-        analogWrite(pinsArray[ii].bPin, blue);
+    if (getBit(overrideBits, n)) {
+        const LedOverride *ov = findOverride(n);
+
+        // The earliest expiration of any layer, since that may change what is shown
+        uint32_t remaining = 0xffffffff;
+        for(const LedOverride *layer = ov; layer < &overrides[overrideCount] && layer->pixel == n; layer++) {
+            uint32_t elapsed = now - layer->startMillis;
+            uint32_t layerRemaining = (elapsed < layer->timeMs) ? (layer->timeMs - elapsed) : 0;
+            if (layerRemaining < remaining) {
+                remaining = layerRemaining;
+            }
+        }
+        if (remaining > 0x7fffffff) {
+            // Keep all deadlines within half of the millis() range so isBefore() works.
+            // It will be rescheduled when this time is reached.
+            remaining = 0x7fffffff;
+        }
+        when = now + remaining;
+        hasDeadline = true;
+        style = ov->state.style;
+        lastTime = ov->state.lastTime;
     }
+    else
+    if (style == STYLE_PATTERN) {
+        // The next frame was computed with the current frame
+        const PatternState *ps = findPattern(n);
+        if (ps->running) {
+            when = isBefore(ps->nextMillis, now) ? now : ps->nextMillis;
+            hasDeadline = true;
+        }
+    }
+
+    if (isBlinkStyle(style) && hasBlinkDeadlines()) {
+        // In blinkSync mode blinking is driven by the shared phase instead of per-pixel deadlines,
+        // and with hardwareBlink it's done by the LED driver chip
+        unsigned long blinkMs = getBlinkMs(style);
+        uint32_t elapsed = now - lastTime;
+        uint32_t blinkWhen = (elapsed < blinkMs) ? (lastTime + blinkMs) : now;
+        if (!hasDeadline || isBefore(blinkWhen, when)) {
+            when = blinkWhen;
+        }
+        hasDeadline = true;
+    }
+
+    if (!hasDeadline) {
+        heapRemove(n);
+        return;
+    }
+
+    size_t index = heapPos[n];
+    if (index == HEAP_POS_NONE) {
+        if (heapSize >= heapCapacity && !reserveHeap(heapSize + 1)) {
+            // Out of memory; the pixel will not blink or expire until it's rescheduled
+            return;
+        }
+        index = heapSize++;
+        heap[index].pixel = n;
+        heap[index].when = when;
+        heapPos[n] = (uint16_t) index;
+        heapSiftUp(index);
+    }
+    else {
+        bool earlier = isBefore(when, heap[index].when);
+        heap[index].when = when;
+        if (earlier) {
+            heapSiftUp(index);
+        }
+        else {
+            heapSiftDown(index);
+        }
+    }
+}
+
+void StatusLedRK::setBlinkSync(bool enable) {
+    WITH_LOCK(*this) {
+        if (enable == blinkSync) {
+            return;
+        }
+        uint32_t now = clockMillis();
+
+        blinkSync = enable;
+        if (blinkSync) {
+            blinkEpoch = now;
+            updateSyncPhase(now);
+        }
+        if (!styles) {
+            // Called before setup(), so there are no pixels to reschedule yet
+            return;
+        }
+
+        // Blink deadlines are added or removed from the heap, and all blinking pixels restart
+        for(size_t ii = 0; ii < numPixels; ii++) {
+            uint16_t n = (uint16_t) ii;
+            if (getBit(overrideBits, n)) {
+                setOverrideBaseLastTime(n, getBlinkStartTime(getStateStyle(n), now));
+                schedulePixel(n, now, 0);
+                markDirty(n);
+            }
+            else
+            if (getStateStyle(n) != STYLE_ON) {
+                schedulePixel(n, now, getBlinkStartTime(getStateStyle(n), now));
+                markDirty(n);
+            }
+        }
+
+        requestShow();
+        wakeThread();
+    }
+}
+
+void StatusLedRK::updateSyncPhase(uint32_t now) {
+    uint32_t elapsed = now - blinkEpoch;
+
+    // The first half of each period is on, so blinking starts on at the epoch
+    syncSlowOn = ((elapsed / SLOW_BLINK_MS) & 1) == 0;
+    nextSlowToggle = now + (SLOW_BLINK_MS - (elapsed % SLOW_BLINK_MS));
+
+    syncFastOn = ((elapsed / FAST_BLINK_MS) & 1) == 0;
+    nextFastToggle = now + (FAST_BLINK_MS - (elapsed % FAST_BLINK_MS));
+}
+
+void StatusLedRK::markStyleDirty(uint8_t style) {
+    if (blinkingCount > 0) {
+        size_t numBytes = (numPixels + 3) / 4;
+        for(size_t ii = 0; ii < numBytes; ii++) {
+            if (styles[ii] == 0) {
+                // All 4 pixels are STYLE_ON
+                continue;
+            }
+            for(size_t jj = 0; jj < 4; jj++) {
+                uint16_t n = (uint16_t)(ii * 4 + jj);
+                if (n < numPixels && getStateStyle(n) == style && !getBit(overrideBits, n)) {
+                    markDirty(n);
+                }
+            }
+        }
+    }
+
+    for(size_t ii = 0; ii < overrideCount; ii++) {
+        if (ii > 0 && overrides[ii - 1].pixel == overrides[ii].pixel) {
+            // Not the top layer, so not visible
+            continue;
+        }
+        if (overrides[ii].state.style == style) {
+            markDirty(overrides[ii].pixel);
+        }
+    }
+}
+
+bool StatusLedRK::getNextDeadline(uint32_t &when) const {
+    bool hasDeadline = false;
+
+    if (frameDeferred) {
+        // End of the frame interval
+        when = lastShowMillis + frameLimitMs;
+        hasDeadline = true;
+    }
+    if (!loopCheckEnabled) {
+        // Nothing is blinking or overridden
+        return hasDeadline;
+    }
+    if (heapSize > 0) {
+        if (!hasDeadline || isBefore(heap[0].when, when)) {
+            when = heap[0].when;
+        }
+        hasDeadline = true;
+    }
+    if (blinkSync && !hardwareBlink) {
+        uint32_t syncWhen = isBefore(nextFastToggle, nextSlowToggle) ? nextFastToggle : nextSlowToggle;
+        if (!hasDeadline || isBefore(syncWhen, when)) {
+            when = syncWhen;
+        }
+        hasDeadline = true;
+    }
+    return hasDeadline;
+}
+
+void StatusLedRK::startThread(os_thread_prio_t priority, size_t stackSize) {
+    if (thread) {
+        return;
+    }
+    if (!mutex) {
+        os_mutex_recursive_create(&mutex);
+    }
+    os_queue_create(&threadQueue, sizeof(uint8_t), 1, 0);
+
+    threadStop = false;
+    thread = new Thread("StatusLedRK", [this]() { return threadFunction(); }, priority, stackSize);
+}
+
+void StatusLedRK::stopThread() {
+    if (!thread) {
+        return;
+    }
+    WITH_LOCK(*this) {
+        threadStop = true;
+    }
+    wakeThread();
+    thread->join();
+    delete thread;
+    thread = 0;
+
+    // Cleared first, as systemLedChanged() can call wakeThread() at any time
+    os_queue_t queue = threadQueue;
+    threadQueue = 0;
+    os_queue_destroy(queue, 0);
+}
+
+void StatusLedRK::startSystemMirror(uint16_t n) {
+    WITH_LOCK(*this) {
+        if (n >= numPixels) {
+            return;
+        }
+        mirrorPixel = n;
+        mirrorColor.store(0);
+        mirrorEnabled = true;
+    }
+    RGB.onChange(&StatusLedRK::systemLedChanged, this);
+
+    // There's no change event until the system LED changes again, so start with its current 
+    // color. If it already changed since onChange(), that color is newer and is kept.
+    uint8_t rgb[3];
+    LED_RGB_Get(rgb);
+    uint32_t expected = 0;
+    mirrorColor.compare_exchange_strong(expected, MIRROR_PENDING | ((uint32_t)rgb[0] << 16) | ((uint32_t)rgb[1] << 8) | (uint32_t)rgb[2]);
+
+    WITH_LOCK(*this) {
+        if (mirrorEnabled && applySystemMirror()) {
+            requestShow();
+        }
+    }
+    wakeThread();
+}
+
+void StatusLedRK::stopSystemMirror() {
+    if (!mirrorEnabled) {
+        return;
+    }
+    RGB.onChange(wiring_rgb_change_handler_t());
+
+    WITH_LOCK(*this) {
+        mirrorEnabled = false;
+    }
+}
+
+void StatusLedRK::systemLedChanged(uint8_t r, uint8_t g, uint8_t b) {
+    // Only the latest color is kept, so a burst of changes is applied once
+    mirrorColor.store(MIRROR_PENDING | ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b, std::memory_order_release);
+
+    // os_queue_put() with no wait is safe from the system LED update, and does nothing without the worker thread
+    wakeThread();
+}
+
+bool StatusLedRK::applySystemMirror() {
+    uint32_t value = mirrorColor.exchange(0, std::memory_order_acquire);
+    if ((value & MIRROR_PENDING) == 0) {
+        return false;
+    }
+    uint32_t color = value & 0xffffff;
+    if (getStateColor(mirrorPixel) == color && getStateStyle(mirrorPixel) == STYLE_ON) {
+        // The system LED went back to the color that's already shown
+        return false;
+    }
+
+    // Not an application change, so clearOnChange overrides stay
+    applyColorStyle(mirrorPixel, color, STYLE_ON, 0, false);
+    updateLoopCheckEnabled();
+    return true;
+}
+
+void StatusLedRK::lock() {
+    if (mutex) {
+        os_mutex_recursive_lock(mutex);
+    }
+}
+
+void StatusLedRK::unlock() {
+    if (mutex) {
+        os_mutex_recursive_unlock(mutex);
+    }
+}
+
+void StatusLedRK::wakeThread() {
+    if (threadQueue) {
+        uint8_t msg = 0;
+        // If the queue is full the thread is already going to wake up
+        os_queue_put(threadQueue, &msg, 0, 0);
+    }
+}
+
+os_thread_return_t StatusLedRK::threadFunction() {
+    bool stop = false;
+
+    while(!stop) {
+        system_tick_t waitMs = CONCURRENT_WAIT_FOREVER;
+
+        WITH_LOCK(*this) {
+            stop = threadStop;
+
+            uint32_t now = clockMillis();
+            bool changed = mirrorEnabled && applySystemMirror();
+            if (loopCheckEnabled && processDueEvents(now)) {
+                changed = true;
+            }
+            if (changed || frameDeferred) {
+                showFrame(now);
+            }
+
+            // Sleep until the next blink change or override expiration, or until woken
+            // by a change from another thread
+            uint32_t when;
+            if (getNextDeadline(when)) {
+                now = clockMillis();
+                waitMs = isBefore(now, when) ? (when - now) : 0;
+            }
+        }
+
+        if (!stop && waitMs > 0) {
+            uint8_t msg;
+            os_queue_take(threadQueue, &msg, waitMs, 0);
+        }
+    }
+}
+
+bool StatusLedRK::reserveHeap(size_t count) {
+    if (count <= heapCapacity) {
+        return true;
+    }
+    if (!ownsStorage) {
+        // Fixed size storage cannot grow
+        return false;
+    }
+
+    size_t newCapacity = (heapCapacity < 8) ? 8 : (heapCapacity * 2);
+    while(newCapacity < count) {
+        newCapacity *= 2;
+    }
+    if (newCapacity > numPixels) {
+        // Each pixel is in the heap at most once
+        newCapacity = numPixels;
+    }
+
+    Deadline *newHeap = new Deadline[newCapacity];
+    if (!newHeap) {
+        return false;
+    }
+    if (heap) {
+        memcpy(newHeap, heap, heapSize * sizeof(Deadline));
+        delete[] heap;
+    }
+    heap = newHeap;
+    heapCapacity = newCapacity;
+    return true;
+}
+
+void StatusLedRK::heapRemove(uint16_t n) {
+    size_t index = heapPos[n];
+    if (index == HEAP_POS_NONE) {
+        return;
+    }
+    heapPos[n] = HEAP_POS_NONE;
+
+    size_t last = --heapSize;
+    if (index != last) {
+        // Move the last entry into the hole and restore the heap
+        heap[index] = heap[last];
+        heapPos[heap[index].pixel] = (uint16_t) index;
+        if (index > 0 && isBefore(heap[index].when, heap[(index - 1) / 2].when)) {
+            heapSiftUp(index);
+        }
+        else {
+            heapSiftDown(index);
+        }
+    }
+}
+
+void StatusLedRK::heapSiftUp(size_t index) {
+    while(index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!isBefore(heap[index].when, heap[parent].when)) {
+            break;
+        }
+        heapSwap(index, parent);
+        index = parent;
+    }
+}
+
+void StatusLedRK::heapSiftDown(size_t index) {
+    while(true) {
+        size_t smallest = index;
+        size_t left = 2 * index + 1;
+        size_t right = left + 1;
+
+        if (left < heapSize && isBefore(heap[left].when, heap[smallest].when)) {
+            smallest = left;
+        }
+        if (right < heapSize && isBefore(heap[right].when, heap[smallest].when)) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        heapSwap(index, smallest);
+        index = smallest;
+    }
+}
+
+void StatusLedRK::heapSwap(size_t a, size_t b) {
+    Deadline temp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = temp;
+
+    heapPos[heap[a].pixel] = (uint16_t) a;
+    heapPos[heap[b].pixel] = (uint16_t) b;
+}
+
+StatusLedRK::LedOverride *StatusLedRK::findOverride(uint16_t n) const {
+    // overrides is sorted by pixel number
+    size_t index = lowerBoundPixel(overrides, overrideCount, n);
+    if (index < overrideCount && overrides[index].pixel == n) {
+        return &overrides[index];
+    }
+    return 0;
+}
+
+StatusLedRK::LedOverride *StatusLedRK::findOverrideLayer(uint16_t n, uint8_t priority) const {
+    // The layers of a pixel are together, highest priority first
+    size_t index = lowerBoundPixel(overrides, overrideCount, n);
+    for(; index < overrideCount && overrides[index].pixel == n; index++) {
+        if (overrides[index].priority == priority) {
+            return &overrides[index];
+        }
+    }
+    return 0;
+}
+
+StatusLedRK::LedOverride *StatusLedRK::insertOverride(uint16_t n, uint8_t priority) {
+    if (overrideCount >= overridesCapacity && !reserveOverrides(overrideCount + 1)) {
+        return 0;
+    }
+
+    // Find the insertion point to keep overrides sorted by pixel number, then highest priority first
+    size_t index = lowerBoundPixel(overrides, overrideCount, n);
+    while(index < overrideCount && overrides[index].pixel == n && overrides[index].priority > priority) {
+        index++;
+    }
+    if (index < overrideCount) {
+        memmove(&overrides[index + 1], &overrides[index], (overrideCount - index) * sizeof(LedOverride));
+    }
+    overrideCount++;
+
+    overrides[index].pixel = n;
+    overrides[index].priority = priority;
+    setBit(overrideBits, n);
+    return &overrides[index];
+}
+
+void StatusLedRK::removeOverride(LedOverride *ov) {
+    size_t index = ov - overrides;
+    uint16_t n = ov->pixel;
+
+    overrideCount--;
+    if (index < overrideCount) {
+        memmove(&overrides[index], &overrides[index + 1], (overrideCount - index) * sizeof(LedOverride));
+    }
+
+    if ((index == 0 || overrides[index - 1].pixel != n) && (index >= overrideCount || overrides[index].pixel != n)) {
+        // That was the last layer for this pixel
+        clearBit(overrideBits, n);
+    }
+}
+
+bool StatusLedRK::removeOverrideLayers(uint16_t n, uint32_t now, bool clearOnChange) {
+    size_t first = findOverride(n) - overrides;
+    size_t index = first;
+    bool topRemoved = false;
+    uint32_t revealTime = now;
+
+    while(index < overrideCount && overrides[index].pixel == n) {
+        LedOverride *ov = &overrides[index];
+        bool remove = clearOnChange ? ov->clearOnChange : (now - ov->startMillis >= ov->timeMs);
+        if (remove) {
+            if (index == first) {
+                if (!clearOnChange) {
+                    // The layer below is shown from when the last layer above it expired, which
+                    // is before now if loop() was late or this is resync()
+                    uint32_t expired = ov->startMillis + ov->timeMs;
+                    if (!topRemoved || isBefore(revealTime, expired)) {
+                        revealTime = expired;
+                    }
+                }
+                topRemoved = true;
+            }
+            if (!clearOnChange) {
+                STATUSLEDRK_STATS(stats.overridesExpired++);
+            }
+            removeOverride(ov);
+        }
+        else {
+            index++;
+        }
+    }
+
+    if (topRemoved && first < overrideCount && overrides[first].pixel == n) {
+        // The next layer down is now shown, and it starts blinking again
+        overrides[first].state.lastTime = getBlinkStartTime(overrides[first].state.style, revealTime);
+        overrides[first].state.blinkState = false;
+    }
+    return topRemoved;
+}
+
+void StatusLedRK::setOverrideBaseLastTime(uint16_t n, uint32_t baseLastTime) {
+    LedOverride *ov = findOverride(n);
+    for(; ov < &overrides[overrideCount] && ov->pixel == n; ov++) {
+        ov->baseLastTime = baseLastTime;
+    }
+}
+
+bool StatusLedRK::reserveOverrides(size_t count) {
+    if (count <= overridesCapacity) {
+        return true;
+    }
+    if (!ownsStorage) {
+        // Fixed size storage cannot grow
+        return false;
+    }
+
+    size_t newCapacity = (overridesCapacity < 4) ? 4 : (overridesCapacity * 2);
+    while(newCapacity < count) {
+        newCapacity *= 2;
+    }
+
+    LedOverride *newOverrides = new LedOverride[newCapacity];
+    if (!newOverrides) {
+        return false;
+    }
+    if (overrides) {
+        memcpy(newOverrides, overrides, overrideCount * sizeof(LedOverride));
+        delete[] overrides;
+    }
+    overrides = newOverrides;
+    overridesCapacity = newCapacity;
+    return true;
+}
+
+StatusLedRK::PatternState *StatusLedRK::findPattern(uint16_t n) const {
+    // patterns is sorted by pixel number
+    size_t index = lowerBoundPixel(patterns, patternCount, n);
+    if (index < patternCount && patterns[index].pixel == n) {
+        return &patterns[index];
+    }
+    return 0;
+}
+
+StatusLedRK::PatternState *StatusLedRK::insertPattern(uint16_t n) {
+    if (patternCount >= patternsCapacity && !reservePatterns(patternCount + 1)) {
+        return 0;
+    }
+
+    // Find the insertion point to keep patterns sorted by pixel number
+    size_t index = lowerBoundPixel(patterns, patternCount, n);
+    if (index < patternCount) {
+        memmove(&patterns[index + 1], &patterns[index], (patternCount - index) * sizeof(PatternState));
+    }
+    patternCount++;
+
+    patterns[index].pixel = n;
+    patterns[index].frameColor = COLOR_BLACK;
+    patterns[index].running = false;
+    return &patterns[index];
+}
+
+void StatusLedRK::removePattern(PatternState *ps) {
+    size_t index = ps - patterns;
+
+    patternCount--;
+    if (index < patternCount) {
+        memmove(&patterns[index], &patterns[index + 1], (patternCount - index) * sizeof(PatternState));
+    }
+}
+
+bool StatusLedRK::reservePatterns(size_t count) {
+    if (count <= patternsCapacity) {
+        return true;
+    }
+    if (!ownsStorage) {
+        // Fixed size storage cannot grow
+        return false;
+    }
+
+    size_t newCapacity = (patternsCapacity < 4) ? 4 : (patternsCapacity * 2);
+    while(newCapacity < count) {
+        newCapacity *= 2;
+    }
+    if (newCapacity > numPixels) {
+        // Each pixel has at most one pattern
+        newCapacity = numPixels;
+    }
+
+    PatternState *newPatterns = new PatternState[newCapacity];
+    if (!newPatterns) {
+        return false;
+    }
+    if (patterns) {
+        memcpy(newPatterns, patterns, patternCount * sizeof(PatternState));
+        delete[] patterns;
+    }
+    patterns = newPatterns;
+    patternsCapacity = newCapacity;
+    return true;
+}
+
+size_t StatusLedRK::getSnapshotSize() {
+    WITH_LOCK(*this) {
+        return snapshotSize(numPixels, overrideCount);
+    }
+    return 0;
+}
+
+size_t StatusLedRK::saveSnapshot(void *buf, size_t bufSize) {
+    WITH_LOCK(*this) {
+        size_t stylesSize = (numPixels + 3) / 4;
+        size_t size = snapshotSize(numPixels, 0);
+        if (!colors || bufSize < size) {
+            return 0;
+        }
+        uint8_t *p = (uint8_t *) buf;
+        uint32_t now = clockMillis();
+
+        memcpy(p + sizeof(SnapshotHeader), colors, numPixels * 3);
+
+        uint8_t *snapStyles = p + sizeof(SnapshotHeader) + numPixels * 3;
+        memcpy(snapStyles, styles, stylesSize);
+        for(size_t ii = 0; ii < patternCount; ii++) {
+            // Patterns are saved as solid
+            uint16_t n = patterns[ii].pixel;
+            snapStyles[n / 4] &= ~(0x3 << ((n % 4) * 2));
+        }
+
+        SnapshotHeader header = {};
+        for(size_t ii = 0; ii < overrideCount && size + sizeof(SnapshotOverride) <= bufSize; ii++) {
+            const LedOverride *ov = &overrides[ii];
+            uint32_t elapsed = now - ov->startMillis;
+            if (elapsed >= ov->timeMs) {
+                // Expired, but loop() has not removed it yet
+                continue;
+            }
+
+            SnapshotOverride so = {};
+            so.color = ov->state.color;
+            so.remainingMs = ov->timeMs - elapsed;
+            so.pixel = ov->pixel;
+            so.style = ov->state.style;
+            so.priority = ov->priority;
+            so.clearOnChange = ov->clearOnChange ? 1 : 0;
+            memcpy(p + size, &so, sizeof(so));
+            size += sizeof(so);
+            header.overrideCount++;
+        }
+
+        header.magic = SNAPSHOT_MAGIC;
+        header.version = SNAPSHOT_VERSION;
+        header.numPixels = (uint16_t) numPixels;
+        memcpy(p, &header, sizeof(header));
+
+        header.checksum = snapshotChecksum(p, size);
+        memcpy(p, &header, sizeof(header));
+        return size;
+    }
+    return 0;
+}
+
+bool StatusLedRK::restoreSnapshot(const void *buf, size_t bufSize) {
+    const uint8_t *p = (const uint8_t *) buf;
+
+    SnapshotHeader header;
+    if (bufSize < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, p, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION || header.numPixels != numPixels) {
+        return false;
+    }
+    size_t size = snapshotSize(numPixels, header.overrideCount);
+    if (bufSize < size || snapshotChecksum(p, size) != header.checksum) {
+        return false;
+    }
+
+    WITH_LOCK(*this) {
+        if (!colors) {
+            // setup() has not been called
+            return false;
+        }
+        uint32_t now = clockMillis();
+        size_t numWords = (numPixels + 31) / 32;
+
+        // Start over from no overrides, patterns, or deadlines, like setup()
+        overrideCount = 0;
+        patternCount = 0;
+        heapSize = 0;
+        blinkingCount = 0;
+        memset(blinkBits, 0, numWords * sizeof(uint32_t));
+        memset(overrideBits, 0, numWords * sizeof(uint32_t));
+        for(size_t ii = 0; ii < numPixels; ii++) {
+            heapPos[ii] = HEAP_POS_NONE;
+        }
+
+        memcpy(colors, p + sizeof(SnapshotHeader), numPixels * 3);
+        memcpy(styles, p + sizeof(SnapshotHeader) + numPixels * 3, (numPixels + 3) / 4);
+
+        size_t numBytes = (numPixels + 3) / 4;
+        for(size_t ii = 0; ii < numBytes; ii++) {
+            if (styles[ii] == 0) {
+                // All 4 pixels are STYLE_ON
+                continue;
+            }
+            for(size_t jj = 0; jj < 4; jj++) {
+                uint16_t n = (uint16_t)(ii * 4 + jj);
+                uint8_t style = (n < numPixels) ? getStateStyle(n) : STYLE_ON;
+                if (style == STYLE_PATTERN) {
+                    // Not saved by saveSnapshot(), but the buffer could come from somewhere else
+                    setStateStyle(n, STYLE_ON);
+                }
+                else
+                if (style != STYLE_ON) {
+                    // Blinking restarts, on
+                    blinkingCount++;
+                    schedulePixel(n, now, getBlinkStartTime(style, now));
+                }
+            }
+        }
+
+        const uint8_t *snapOverrides = p + snapshotSize(numPixels, 0);
+        for(size_t ii = 0; ii < header.overrideCount; ii++) {
+            SnapshotOverride so;
+            memcpy(&so, snapOverrides + ii * sizeof(so), sizeof(so));
+            if (so.pixel < numPixels && so.remainingMs > 0) {
+                uint8_t style = (so.style == STYLE_PATTERN) ? STYLE_ON : so.style;
+                applyOverride(so.pixel, so.color, style, so.remainingMs, so.clearOnChange != 0, so.priority, now);
+            }
+        }
+
+        updateLoopCheckEnabled();
+        markAllDirty();
+        requestShow();
+    }
+    wakeThread();
+    return true;
+}
+
+size_t StatusLedRK::getMemoryUsage() const {
+    size_t numWords = (numPixels + 31) / 32;
+
+    if (!ownsStorage) {
+        // Fixed size storage is not allocated from the heap
+        return 0;
+    }
+
+    return numPixels * 3 // colors
+        + (numPixels + 3) / 4 // styles
+        + 3 * numWords * sizeof(uint32_t) // blinkBits, overrideBits, dirty
+        + numPixels * sizeof(uint16_t) // heapPos
+        + heapCapacity * sizeof(Deadline)
+        + overridesCapacity * sizeof(LedOverride)
+        + patternsCapacity * sizeof(PatternState)
+        + (outputTable ? (3 * 256) : 0)
+        + (pixelBrightness ? numPixels : 0);
+}
+
+StatusLedRK::Stats StatusLedRK::getStats() {
+    Stats result = {};
+#if STATUSLEDRK_ENABLE_STATS
+    WITH_LOCK(*this) {
+        result = stats;
+    }
+#endif
+    return result;
+}
+
+void StatusLedRK::resetStats() {
+#if STATUSLEDRK_ENABLE_STATS
+    WITH_LOCK(*this) {
+        stats = {};
+    }
+#endif
+}
+
+void StatusLedRK::logStats() {
+#if STATUSLEDRK_ENABLE_STATS
+    Stats s = getStats();
+
+    Log.info("StatusLedRK loop calls=%lu min=%lu max=%lu avg=%lu us", 
+        (unsigned long) s.loopCalls, (unsigned long) s.loopMinUs, (unsigned long) s.loopMaxUs, 
+        (unsigned long) (s.loopCalls ? (s.loopTotalUs / s.loopCalls) : 0));
+    Log.info("StatusLedRK show calls=%lu min=%lu max=%lu avg=%lu us pixels=%lu", 
+        (unsigned long) s.showCalls, (unsigned long) s.showMinUs, (unsigned long) s.showMaxUs, 
+        (unsigned long) (s.showCalls ? (s.showTotalUs / s.showCalls) : 0), (unsigned long) s.pixelsWritten);
+    Log.info("StatusLedRK blinkToggles=%lu patternFrames=%lu overridesExpired=%lu showsDeferred=%lu", 
+        (unsigned long) s.blinkToggles, (unsigned long) s.patternFrames, (unsigned long) s.overridesExpired,
+        (unsigned long) s.showsDeferred);
+#else
+    Log.info("StatusLedRK stats are not enabled, define STATUSLEDRK_ENABLE_STATS=1");
+#endif
+}
+
+void StatusLedRK::updateLoopCheckEnabled() {
+    // If there is an override or blinking is enabled, a loop check is required
+    loopCheckEnabled = (overrideCount > 0 || blinkingCount > 0);
+}
+
+
+void StatusLedRK::show() {
+    WITH_LOCK(*this) {
+        if (!anyDirty) {
+            return;
+        }
+        if (frameLimitMs != 0) {
+            // Every refresh starts a new frame limit interval, including a direct call to show()
+            lastShowMillis = clockMillis();
+            frameDeferred = false;
+        }
+        STATUSLEDRK_STATS(uint32_t startUs = micros());
+
+        size_t numWords = (numPixels + 31) / 32;
+        for(size_t word = 0; word < numWords; word++) {
+            uint32_t bits = dirty[word];
+            if (bits == 0) {
+                // None of these 32 pixels changed
+                continue;
+            }
+            dirty[word] = 0;
+
+            // Resolve the changed pixels in this word, then convert them in one pass
+            uint16_t pixels[32];
+            uint32_t outColors[32];
+            size_t count = 0;
+            for(uint16_t bit = 0; bits != 0; bit++, bits >>= 1) {
+                if (bits & 1) {
+                    uint16_t n = (uint16_t)(word * 32 + bit);
+                    pixels[count] = n;
+                    outColors[count++] = resolveColor(n);
+                }
+            }
+            if (correctOutput) {
+                correctColors(pixels, outColors, count);
+            }
+            showPixels(pixels, outColors, count);
+            STATUSLEDRK_STATS(stats.pixelsWritten += count);
+        }
+        anyDirty = false;
+
+        showComplete();
+
+#if STATUSLEDRK_ENABLE_STATS
+        uint32_t elapsedUs = micros() - startUs;
+        if (stats.showCalls++ == 0 || elapsedUs < stats.showMinUs) {
+            stats.showMinUs = elapsedUs;
+        }
+        if (elapsedUs > stats.showMaxUs) {
+            stats.showMaxUs = elapsedUs;
+        }
+        stats.showTotalUs += elapsedUs;
+#endif
+    }
+}
+
+void StatusLedRK::correctColors(const uint16_t *pixels, uint32_t *colorsArray, size_t count) const {
+    const uint8_t *redTable = &outputTable[0];
+    const uint8_t *greenTable = &outputTable[256];
+    const uint8_t *blueTable = &outputTable[512];
+
+    if (usePixelBrightness) {
+        // Scale before gamma so dimming a pixel looks like dimming the LED
+        for(size_t ii = 0; ii < count; ii++) {
+            uint32_t scale = (uint32_t)pixelBrightness[pixels[ii]] + 1;
+            uint32_t c = colorsArray[ii];
+            colorsArray[ii] = ((uint32_t)redTable[(((c >> 16) & 0xff) * scale) >> 8] << 16)
+                | ((uint32_t)greenTable[(((c >> 8) & 0xff) * scale) >> 8] << 8)
+                | (uint32_t)blueTable[((c & 0xff) * scale) >> 8];
+        }
+    }
+    else {
+        for(size_t ii = 0; ii < count; ii++) {
+            uint32_t c = colorsArray[ii];
+            colorsArray[ii] = ((uint32_t)redTable[(c >> 16) & 0xff] << 16)
+                | ((uint32_t)greenTable[(c >> 8) & 0xff] << 8)
+                | (uint32_t)blueTable[c & 0xff];
+        }
+    }
+}
+
+bool StatusLedRK::buildOutputTable() {
+    bool identity = (brightness == 255 && gammaRed == 1.0f && gammaGreen == 1.0f && gammaBlue == 1.0f);
+
+    correctOutput = usePixelBrightness || !identity;
+    if (!correctOutput) {
+        // Colors are written unchanged, so the table is not used
+        return true;
+    }
+
+    if (!outputTable) {
+        if (!ownsStorage) {
+            // Fixed size storage without OUTPUT_CORRECTION
+            correctOutput = false;
+            return false;
+        }
+        outputTable = new uint8_t[3 * 256];
+        if (!outputTable) {
+            correctOutput = false;
+            return false;
+        }
+    }
+
+    // The exponent is only computed here, not when pixels are shown
+    const float gammas[3] = { gammaRed, gammaGreen, gammaBlue };
+    for(size_t channel = 0; channel < 3; channel++) {
+        uint8_t *table = &outputTable[channel * 256];
+        for(size_t ii = 0; ii < 256; ii++) {
+            float value = (gammas[channel] == 1.0f) ? (float)ii : (powf((float)ii / 255.0f, gammas[channel]) * 255.0f);
+            table[ii] = (uint8_t)((value * (float)brightness) / 255.0f + 0.5f);
+        }
+    }
+    return true;
+}
+
+void StatusLedRK::setBrightness(uint8_t brightness) {
+    WITH_LOCK(*this) {
+        if (brightness == this->brightness) {
+            return;
+        }
+        this->brightness = brightness;
+        buildOutputTable();
+
+        if (dirty) {
+            markAllDirty();
+            requestShow();
+        }
+    }
+}
+
+void StatusLedRK::setGamma(float red, float green, float blue) {
+    WITH_LOCK(*this) {
+        gammaRed = red;
+        gammaGreen = green;
+        gammaBlue = blue;
+        buildOutputTable();
+
+        if (dirty) {
+            markAllDirty();
+            requestShow();
+        }
+    }
+}
+
+void StatusLedRK::setPixelBrightness(uint16_t n, uint8_t brightness, bool showNow) {
+    WITH_LOCK(*this) {
+        if (n >= numPixels) {
+            return;
+        }
+        if (!usePixelBrightness) {
+            if (!pixelBrightness) {
+                if (!ownsStorage) {
+                    // Fixed size storage without OUTPUT_CORRECTION
+                    return;
+                }
+                pixelBrightness = new uint8_t[numPixels];
+                if (!pixelBrightness) {
+                    return;
+                }
+            }
+            memset(pixelBrightness, 255, numPixels);
+            usePixelBrightness = true;
+            buildOutputTable();
+        }
+        if (pixelBrightness[n] == brightness) {
+            return;
+        }
+        pixelBrightness[n] = brightness;
+
+        if (dirty) {
+            markDirty(n);
+            if (showNow) {
+                requestShow();
+            }
+        }
+    }
+}
+
+void StatusLedRK::showPixels(const uint16_t *pixels, const uint32_t *colorsArray, size_t count) {
+    for(size_t ii = 0; ii < count; ii++) {
+        showPixel(pixels[ii], colorsArray[ii]);
+    }
+}
+
+void StatusLedRK::showAll() {
+    WITH_LOCK(*this) {
+        invalidateCache();
+        markAllDirty();
+        show();
+    }
+}
+
+void StatusLedRK::markAllDirty() {
+    size_t numWords = (numPixels + 31) / 32;
+    for(size_t word = 0; word < numWords; word++) {
+        dirty[word] = 0xffffffff;
+    }
+    if (numPixels % 32) {
+        // Don't mark the unused bits in the last word
+        dirty[numWords - 1] = (1ul << (numPixels % 32)) - 1;
+    }
+    anyDirty = true;
+}
+
+void StatusLedRK::clearDirty() {
+    size_t numWords = (numPixels + 31) / 32;
+    for(size_t word = 0; word < numWords; word++) {
+        dirty[word] = 0;
+    }
+    anyDirty = false;
+}
+
+
+StatusLedRK_RGB::StatusLedRK_RGB(size_t numPixels, const LedPins *pinsArray, bool isCommonAnode) : StatusLedRK(numPixels), pinsArray(pinsArray), isCommonAnode(isCommonAnode) {
+}
+
+StatusLedRK_RGB::~StatusLedRK_RGB() {
+    stopSystemMirror();
+    stopThread();
+
+    if (outputCache && ownsStorage) {
+        delete[] outputCache;
+    }
+}
+
+void StatusLedRK_RGB::setup2() {
+    // Every channel is written by the first show(), which fills in the cache
+    if (!outputCache && ownsStorage) {
+        outputCache = new uint8_t[numPixels * OUTPUT_CACHE_BYTES_PER_PIXEL];
+    }
+    cacheValid = false;
+
+    for(size_t ii = 0; ii < numPixels; ii++) {
+        pinMode(pinsArray[ii].rPin, OUTPUT);
+        pinMode(pinsArray[ii].gPin, OUTPUT);
+        pinMode(pinsArray[ii].bPin, OUTPUT);
+    }
+
+}
+
+
+void StatusLedRK_RGB::showPixel(uint16_t n, uint32_t color)  {
+    uint8_t red = (uint8_t) (color >> 16);
+    uint8_t green = (uint8_t) (color >> 8);
+    uint8_t blue = (uint8_t) color;
+
+    if (isCommonAnode) {
+        red = 255 - red;
+        green = 255 - green;
+        blue = 255 - blue;
+    }
+
+    writeChannel(n * 3, pinsArray[n].rPin, red);
+    writeChannel(n * 3 + 1, pinsArray[n].gPin, green);
+    writeChannel(n * 3 + 2, pinsArray[n].bPin, blue);
+}
+
+void StatusLedRK_RGB::writeChannel(size_t index, pin_t pin, uint8_t value) {
+    if (outputCache) {
+        if (cacheValid && outputCache[index] == value) {
+            // Unchanged, so don't reconfigure the PWM
+            return;
+        }
+        outputCache[index] = value;
+    }
+
+    if (value == 0) {
+        digitalWrite(pin, LOW);
+    }
+    else
+    if (value == 255) {
+        digitalWrite(pin, HIGH);
+    }
+    else {
+        analogWrite(pin, value);
+    }
+}
+
+
+bool StatusLedRK_Composite::addOutput(StatusLedRK *output, uint16_t firstPixel, uint16_t count, uint16_t outputFirst) {
+    return addOutputMapping(output, 0, firstPixel, count, outputFirst);
+}
+
+bool StatusLedRK_Composite::addOutputMap(StatusLedRK *output, const uint16_t *pixelMap, uint16_t count) {
+    return addOutputMapping(output, pixelMap, 0, count, 0);
+}
+
+bool StatusLedRK_Composite::addOutputSegments(StatusLedRK *output, const Segment *segments, uint16_t count) {
+    if (!addOutputMapping(output, 0, 0, count, 0)) {
+        return false;
+    }
+    outputs[outputCount - 1].segments = segments;
+    return true;
+}
+
+bool StatusLedRK_Composite::addOutputMapping(StatusLedRK *output, const uint16_t *pixelMap, uint16_t firstPixel, uint16_t count, uint16_t outputFirst) {
+    if (outputCount >= MAX_OUTPUTS || !output) {
+        return false;
+    }
+
+    // Blinking is done here so every output blinks in the same phase
+    output->hardwareBlink = false;
+
+    Output *o = &outputs[outputCount++];
+    o->output = output;
+    o->pixelMap = pixelMap;
+    o->segments = 0;
+    o->firstPixel = firstPixel;
+    o->count = count;
+    o->outputFirst = outputFirst;
+    o->written = false;
+    return true;
+}
+
+void StatusLedRK_Composite::setup2() {
+    for(size_t ii = 0; ii < outputCount; ii++) {
+        outputs[ii].output->setup2();
+    }
+}
+
+void StatusLedRK_Composite::showPixels(const uint16_t *pixels, const uint32_t *colorsArray, size_t count) {
+    for(size_t ii = 0; ii < outputCount; ii++) {
+        Output *o = &outputs[ii];
+        size_t outputPixels = o->output->getNumPixels();
+
+        // Translate to the output's pixel numbers and write them as one batch
+        uint16_t outPixels[32];
+        uint32_t outColors[32];
+        size_t outCount = 0;
+        for(size_t jj = 0; jj < count; jj++) {
+            uint16_t offset = (uint16_t)(pixels[jj] - o->firstPixel);
+            if (pixels[jj] < o->firstPixel || offset >= o->count) {
+                continue;
+            }
+            uint16_t target;
+            uint16_t targetCount = 1;
+            if (o->segments) {
+                // A group of output pixels, all the same color
+                target = o->segments[offset].first;
+                targetCount = o->segments[offset].count;
+            }
+            else
+            if (o->pixelMap) {
+                target = o->pixelMap[offset];
+                if (target == NO_PIXEL) {
+                    continue;
+                }
+            }
+            else {
+                target = (uint16_t)(o->outputFirst + offset);
+            }
+
+            for(uint16_t kk = 0; kk < targetCount && (size_t)target + kk < outputPixels; kk++) {
+                outPixels[outCount] = (uint16_t)(target + kk);
+                outColors[outCount++] = colorsArray[jj];
+
+                if (outCount == sizeof(outPixels) / sizeof(outPixels[0])) {
+                    o->output->showPixels(outPixels, outColors, outCount);
+                    o->written = true;
+                    outCount = 0;
+                }
+            }
+        }
+        if (outCount) {
+            o->output->showPixels(outPixels, outColors, outCount);
+            o->written = true;
+        }
+    }
+}
+
+void StatusLedRK_Composite::showComplete() {
+    for(size_t ii = 0; ii < outputCount; ii++) {
+        if (outputs[ii].written) {
+            outputs[ii].written = false;
+            outputs[ii].output->showComplete();
+        }
+    }
+}
+
+void StatusLedRK_Composite::invalidateCache() {
+    for(size_t ii = 0; ii < outputCount; ii++) {
+        outputs[ii].output->invalidateCache();
+    }
+}
+
+size_t StatusLedRK_StreamDecoder::process(Stream &stream) {
+    size_t frames = 0;
+
+    WITH_LOCK(*led) {
+        // Frames completed during this call are shown once, at the end
+        led->beginUpdate();
+        while(stream.available() > 0) {
+            int c = stream.read();
+            if (c < 0) {
+                break;
+            }
+            if (decodeByte((uint8_t) c)) {
+                frames++;
+            }
+        }
+        led->commit();
+    }
+    return frames;
+}
+
+bool StatusLedRK_StreamDecoder::processByte(uint8_t b) {
+    WITH_LOCK(*led) {
+        return decodeByte(b);
+    }
+    return false;
+}
+
+bool StatusLedRK_StreamDecoder::decodeByte(uint8_t b) {
+    switch(state) {
+        case STATE_IDLE:
+            if (b == FRAME_START) {
+                state = STATE_COMMAND;
+            }
+            break;
+
+        case STATE_COMMAND:
+            command = b;
+            paramsLen = 0;
+            switch(command) {
+                case CMD_END:
+                    endFrame();
+                    frameCount++;
+                    state = STATE_IDLE;
+                    return true;
+
+                case CMD_FILL:
+                    paramsNeeded = 8;
+                    break;
+
+                case CMD_RUNS:
+                case CMD_STYLES:
+                    paramsNeeded = 4;
+                    break;
+
+                case CMD_OVERRIDE:
+                    paramsNeeded = 12;
+                    break;
+
+                case FRAME_START:
+                    // The end of the last frame was lost, so show it and start a new one
+                    endFrame();
+                    errorCount++;
+                    return false;
+
+                default:
+                    // Probably lost sync
+                    protocolError();
+                    return false;
+            }
+            state = STATE_PARAMS;
+            break;
+
+        case STATE_PARAMS:
+            params[paramsLen++] = b;
+            if (paramsLen == paramsNeeded) {
+                state = STATE_COMMAND;
+                executeCommand();
+            }
+            break;
+
+        case STATE_RUN:
+            params[paramsLen++] = b;
+            if (paramsLen == 4) {
+                uint32_t color = getParamColor(1);
+                for(uint8_t ii = 0; ii < params[0] && pixel < led->numPixels; ii++) {
+                    setPixel((uint16_t)pixel++, color, style);
+                }
+                paramsLen = 0;
+                if (--remaining == 0) {
+                    state = STATE_COMMAND;
+                }
+            }
+            break;
+
+        case STATE_STYLES:
+            for(size_t ii = 0; ii < 4 && remaining > 0; ii++, remaining--) {
+                uint8_t pixelStyle = (b >> (ii * 2)) & 0x3;
+                if (!checkStyle(pixelStyle)) {
+                    return false;
+                }
+                if (pixel < led->numPixels) {
+                    uint16_t n = (uint16_t)pixel++;
+                    setPixel(n, led->getStateColor(n), pixelStyle);
+                }
+            }
+            if (remaining == 0) {
+                state = STATE_COMMAND;
+            }
+            break;
+    }
+    return false;
+}
+
+void StatusLedRK_StreamDecoder::executeCommand() {
+    switch(command) {
+        case CMD_FILL: {
+            uint16_t first = getParam16(0);
+            uint16_t count = getParam16(2);
+            uint32_t color = getParamColor(4);
+            if (!checkStyle(params[7])) {
+                break;
+            }
+            if (first >= led->numPixels) {
+                // Past the end of the pixels, and first + ii could wrap around to 0
+                break;
+            }
+            if (count > led->numPixels - first) {
+                count = (uint16_t)(led->numPixels - first);
+            }
+            for(uint16_t ii = 0; ii < count; ii++) {
+                setPixel((uint16_t)(first + ii), color, params[7]);
+            }
+            break;
+        }
+
+        case CMD_RUNS:
+            pixel = getParam16(0);
+            style = params[2];
+            remaining = params[3];
+            if (!checkStyle(style)) {
+                break;
+            }
+            if (remaining) {
+                paramsLen = 0;
+                state = STATE_RUN;
+            }
+            break;
+
+        case CMD_STYLES:
+            pixel = getParam16(0);
+            remaining = getParam16(2);
+            if (remaining) {
+                state = STATE_STYLES;
+            }
+            break;
+
+        case CMD_OVERRIDE: {
+            uint16_t n = getParam16(0);
+            uint32_t howLong = (uint32_t)getParam16(6) | ((uint32_t)getParam16(8) << 16);
+            if (!checkStyle(params[5])) {
+                break;
+            }
+            if (n < led->numPixels) {
+                led->applyOverride(n, getParamColor(2), params[5], howLong, (params[11] & 0x01) != 0, params[10], led->clockMillis());
+                inFrame = true;
+            }
+            break;
+        }
+    }
+}
+
+void StatusLedRK_StreamDecoder::setPixel(uint16_t n, uint32_t color, uint8_t style) {
+    if (n >= led->numPixels) {
+        return;
+    }
+    led->applyColorStyle(n, color, style, 0);
+    inFrame = true;
+}
+
+bool StatusLedRK_StreamDecoder::checkStyle(uint8_t style) {
+    if (style <= StatusLedRK::STYLE_BLINK_FAST) {
+        return true;
+    }
+    // STYLE_PATTERN can't be sent in the stream, and anything larger means the data is corrupt
+    protocolError();
+    return false;
+}
+
+void StatusLedRK_StreamDecoder::protocolError() {
+    // Show what was received and wait for the next frame
+    endFrame();
+    errorCount++;
+    state = STATE_IDLE;
+}
+
+void StatusLedRK_StreamDecoder::endFrame() {
+    if (!inFrame) {
+        return;
+    }
+    inFrame = false;
+
+    // Deferred until commit() if called from process()
+    led->updateLoopCheckEnabled();
+    led->requestShow();
+    led->wakeThread();
 }
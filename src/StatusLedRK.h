@@ -6,6 +6,69 @@
 
 #include "Particle.h"
 
+#include <atomic>
+#include <type_traits>
+
+#ifndef STATUSLEDRK_ENABLE_STATS
+/**
+ * @brief Set to 1 (before including this file, or as a compiler flag) to enable getStats()
+ * 
+ * When 0 (the default), the counters and timing are compiled out and getStats() returns all zeros.
+ */
+#define STATUSLEDRK_ENABLE_STATS 0
+#endif
+
+/**
+ * @brief Interface for the time source used by StatusLedRK, see StatusLedRK::setClock()
+ */
+class StatusLedRK_Clock {
+public:
+    /**
+     * @brief Destructor
+     */
+    virtual ~StatusLedRK_Clock() {}
+
+    /**
+     * @brief Get the current time in milliseconds. Like millis(), this can roll over.
+     */
+    virtual uint32_t getMillis() = 0;
+};
+
+/**
+ * @brief Clock that only changes when it's set or advanced
+ * 
+ * This is used to test or simulate blinking and overrides without waiting for them.
+ * For example, advancing the clock by 10 ms and calling loop() 360000 times runs an hour 
+ * of blinking as quickly as loop() can be called.
+ */
+class StatusLedRK_ManualClock : public StatusLedRK_Clock {
+public:
+    /**
+     * @brief Construct the clock
+     * 
+     * @param value Initial time in milliseconds
+     */
+    StatusLedRK_ManualClock(uint32_t value = 0) : value(value) {}
+
+    /**
+     * @brief Get the current time in milliseconds
+     */
+    virtual uint32_t getMillis() { return value; };
+
+    /**
+     * @brief Set the current time in milliseconds
+     */
+    void set(uint32_t ms) { value = ms; };
+
+    /**
+     * @brief Advance the current time by ms milliseconds
+     */
+    void advance(uint32_t ms) { value += ms; };
+
+protected:
+    uint32_t value; //!< Current time in milliseconds
+};
+
 
 /**
  * @brief Class for managing one or more status LEDs
@@ -27,14 +90,154 @@ public:
 
     /**
      * @brief Structure used to temporarily override the status LED color
+     * 
+     * Overrides are kept in a small pool sorted by pixel number, so only pixels that
+     * are currently overridden use one of these. A pixel can have several overrides
+     * (layers) with different priorities; they're stored together, highest priority first,
+     * so the first one is the one that is shown.
      */
     typedef struct {
         PixelState state; //!< The state of the LED override (on, blinking, and color)
         unsigned long startMillis; //!< When the override started (millis value)
         unsigned long timeMs; //!< Duration of the override in milliseconds
+        uint32_t baseLastTime; //!< Last blink change millis() of the underlying (non-override) state, restored when the override ends
+        uint16_t pixel; //!< Pixel number this override applies to
+        uint8_t priority; //!< Layer priority. Higher priority layers are shown over lower ones.
         bool clearOnChange; //!< If true, if the color of the pixel is set while overridden, the override is removed.
     } LedOverride;
 
+    /**
+     * @brief Entry in the deadline scheduler min-heap
+     */
+    typedef struct {
+        uint32_t when; //!< millis() value when the pixel next needs attention (blink toggle or override expiry)
+        uint16_t pixel; //!< Pixel number
+    } Deadline;
+
+    /**
+     * @brief One step of an animation pattern
+     *
+     * The pattern goes from this keyframe's color to the next keyframe's color over
+     * durationMs, using the easing curve. With EASING_STEP the color of this keyframe
+     * is held for durationMs instead.
+     */
+    typedef struct {
+        uint32_t color; //!< RGB color, or keyframeLevel() to use the pixel's color at a brightness level
+        uint16_t durationMs; //!< Time to get to the next keyframe in milliseconds. Ignored for the last keyframe of a pattern that does not repeat.
+        uint8_t easing; //!< One of the EASING_ constants
+    } Keyframe;
+
+    /**
+     * @brief An animation pattern made of a list of keyframes
+     *
+     * The pattern is not copied, so it and its keyframes are typically const globals. For example,
+     * a repeating red, green, blue sequence:
+     *
+     * ```
+     * const StatusLedRK::Keyframe rgbKeyframes[] = {
+     *     { StatusLedRK::COLOR_RED, 500, StatusLedRK::EASING_STEP },
+     *     { StatusLedRK::COLOR_GREEN, 500, StatusLedRK::EASING_STEP },
+     *     { StatusLedRK::COLOR_BLUE, 500, StatusLedRK::EASING_STEP }
+     * };
+     * const StatusLedRK::Pattern rgbPattern = { rgbKeyframes, 3, true };
+     * ```
+     */
+    typedef struct {
+        const Keyframe *keyframes; //!< Array of keyframes
+        uint8_t count; //!< Number of entries in keyframes
+        bool repeat; //!< true to go from the last keyframe back to the first, false to stop at the last keyframe
+    } Pattern;
+
+    /**
+     * @brief State of a pixel that is displaying a pattern
+     *
+     * Kept in a small pool sorted by pixel number, so only pixels using STYLE_PATTERN use one of these.
+     */
+    typedef struct {
+        const Pattern *pattern; //!< The pattern being displayed
+        uint32_t startMillis; //!< When the pattern started (millis value)
+        uint32_t nextMillis; //!< millis() value when the next frame is due, if running
+        uint32_t frameColor; //!< Color of the current frame
+        uint16_t pixel; //!< Pixel number this pattern applies to
+        bool running; //!< false if the pattern has finished or does not change
+    } PatternState;
+
+    /**
+     * @brief Performance counters returned by getStats()
+     * 
+     * Times are in microseconds from micros(). These are only kept if STATUSLEDRK_ENABLE_STATS is 1.
+     */
+    typedef struct {
+        uint32_t loopCalls; //!< Number of calls to loop()
+        uint32_t loopMinUs; //!< Shortest loop() call
+        uint32_t loopMaxUs; //!< Longest loop() call
+        uint64_t loopTotalUs; //!< Total time in loop(), divide by loopCalls for the average
+        uint32_t showCalls; //!< Number of calls to show() that wrote at least one pixel
+        uint32_t showMinUs; //!< Shortest show() that wrote pixels
+        uint32_t showMaxUs; //!< Longest show() that wrote pixels
+        uint64_t showTotalUs; //!< Total time in show(), divide by showCalls for the average
+        uint32_t pixelsWritten; //!< Number of pixels passed to the hardware by show()
+        uint32_t blinkToggles; //!< Number of per-pixel blink on/off changes
+        uint32_t patternFrames; //!< Number of pattern frames that changed a pixel color
+        uint32_t overridesExpired; //!< Number of overrides that ended because their time ran out
+        uint32_t showsDeferred; //!< Number of show requests delayed by setFrameLimitMs()
+    } Stats;
+
+    /**
+     * @brief Definition of a device status, used with setStatusTable() and setStatus()
+     * 
+     * A table of these is typically a constexpr global so it's stored in flash. The status ID
+     * is the index into the table, so an enum works well. For example:
+     * 
+     * ```
+     * enum { STATUS_OK, STATUS_LOW_BATTERY, STATUS_BUTTON };
+     * 
+     * constexpr StatusLedRK::StatusDefinition statusTable[] = {
+     *     { "ok", StatusLedRK::COLOR_GREEN, StatusLedRK::STYLE_ON, nullptr, 0, 0, false },
+     *     { "lowBattery", StatusLedRK::COLOR_RED, StatusLedRK::STYLE_BLINK_SLOW, nullptr, 0, 0, false },
+     *     { "button", StatusLedRK::COLOR_WHITE, StatusLedRK::STYLE_ON, nullptr, 500, 1, false },
+     * };
+     * ```
+     */
+    typedef struct {
+        const char *name; //!< Name of the status, for logging. Can be NULL.
+        uint32_t color; //!< RGB color. See constants like COLOR_RED, below.
+        uint8_t style; //!< One of STYLE_ON, STYLE_BLINK_SLOW, STYLE_BLINK_FAST, STYLE_PATTERN.
+        const Pattern *pattern; //!< Pattern to use if style is STYLE_PATTERN, otherwise NULL
+        unsigned long howLong; //!< 0 to set the color of the pixel, or milliseconds to override it for
+        uint8_t priority; //!< Override layer priority, if howLong is not 0
+        bool clearOnChange; //!< Override clearOnChange, if howLong is not 0
+    } StatusDefinition;
+
+    /**
+     * @brief Start of a snapshot made by saveSnapshot()
+     * 
+     * It's followed by the packed colors (3 bytes per pixel), the packed styles (4 pixels 
+     * per byte), and overrideCount SnapshotOverride entries. The data is in the byte order 
+     * of the device, since it's intended to be restored on the same device.
+     */
+    typedef struct {
+        uint32_t magic; //!< SNAPSHOT_MAGIC
+        uint16_t version; //!< SNAPSHOT_VERSION
+        uint16_t numPixels; //!< Number of pixels, must match the object it's restored to
+        uint16_t overrideCount; //!< Number of SnapshotOverride entries
+        uint16_t reserved; //!< Always 0
+        uint32_t checksum; //!< FNV-1a hash of the snapshot, not including this field
+    } SnapshotHeader;
+
+    /**
+     * @brief One override layer in a snapshot
+     */
+    typedef struct {
+        uint32_t color; //!< Color of the override
+        uint32_t remainingMs; //!< Milliseconds left when the snapshot was made
+        uint16_t pixel; //!< Pixel number
+        uint8_t style; //!< Style of the override
+        uint8_t priority; //!< Layer priority
+        uint8_t clearOnChange; //!< 1 if clearOnChange was set
+        uint8_t reserved[3]; //!< Always 0
+    } SnapshotOverride;
+
 
 public:
     /**
@@ -46,10 +249,21 @@ public:
      * of the concrete subclasses like StatusLedRK_RGB instead.
      */
     StatusLedRK(size_t numPixels);
+
+    /**
+     * @brief Destructor. Stops the worker thread and the system LED mirror if they are running.
+     * 
+     * The base class destructor runs after the subclass members are destroyed, while the worker 
+     * thread could still be calling showPixel() of the subclass. Subclasses must call stopThread()
+     * and stopSystemMirror() at the start of their own destructor, as the classes in this library do.
+     */
     virtual ~StatusLedRK();
 
     /**
      * @brief This must be called from application setup().
+     *
+     * If there is not enough memory for the pixels, an error is logged and the object has no
+     * pixels (getNumPixels() returns 0), so calls that set or get pixels are ignored.
      */
     virtual void setup();
 
@@ -58,16 +272,129 @@ public:
      * 
      * The LEDs are only updated during loop(), so you should call this as frequently as possible.
      * It's efficient so it won't update the hardware when the pixels do not change.
+     * 
+     * If you use startThread(), you do not need to call loop(), though it's harmless to do so.
      */
 	virtual void loop();
 
+    /**
+     * @brief Update the LEDs from a worker thread instead of loop()
+     * 
+     * @param priority Thread priority. Default: OS_THREAD_PRIORITY_DEFAULT.
+     * @param stackSize Thread stack size in bytes. Default: 1024.
+     * 
+     * Call this from setup(), after setup() of this object. The thread sleeps until the next
+     * blink change or override expiration, so blinking continues while the application loop
+     * is blocked. It also enables locking, so the public methods of this class can be called
+     * from any thread.
+     * 
+     * Because show() is called from the worker thread, your show(), showPixel(), and 
+     * showComplete() methods must be safe to call from a thread other than loop.
+     */
+    void startThread(os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT, size_t stackSize = 1024);
+
+    /**
+     * @brief Stop the worker thread started by startThread()
+     * 
+     * Locking remains enabled after the thread is stopped. It's safe to call this if the thread
+     * is not running.
+     */
+    void stopThread();
+
+    /**
+     * @brief Mirror the system status LED (the built-in RGB LED) on a pixel
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * 
+     * Uses RGB.onChange() so there is no polling. The pixel is set to the current system LED
+     * color right away. After that, the change handler only saves the latest color without 
+     * locking or allocating, and wakes the worker thread if there is one. loop() (or the worker 
+     * thread) sets the pixel to it. Changes that happen between calls to loop(), such as the steps of the breathing 
+     * pattern, are combined, and only the last one is shown. The pixel can still be overridden
+     * using setOverrideStyle().
+     * 
+     * Only one StatusLedRK object can mirror the system LED at a time, as RGB.onChange() 
+     * only has one handler.
+     */
+    void startSystemMirror(uint16_t n);
+
+    /**
+     * @brief Stop mirroring the system status LED. The pixel keeps its current color.
+     */
+    void stopSystemMirror();
+
+    /**
+     * @brief Lock the object. Only does anything after startThread() has been called.
+     * 
+     * The lock is recursive and is used internally by the public methods. You can use 
+     * WITH_LOCK(statusLed) to make several calls atomic with respect to the worker thread.
+     */
+    void lock();
+
+    /**
+     * @brief Unlock the object locked with lock()
+     */
+    void unlock();
+
     /**
      * @brief Update the hardware to match the current pixel state
      * 
-     * This is only called when a pixel changes color (not continuously). This method
-     * is pure virtual and must be overridden in a subclass.
+     * This is only called when a pixel changes color (not continuously). The default 
+     * implementation calls showPixel() for each pixel that changed since the last show()
+     * and then showComplete() if any pixel was written, so subclasses normally override
+     * those instead. Subclasses can still override show() to refresh everything at once.
+     * 
+     * Calling show() directly is not limited by setFrameLimitMs(), so it can be used after
+     * a latency-critical change to display it immediately. The object is locked while it 
+     * runs, so it's safe to call while the worker thread is running.
+     */
+    virtual void show();
+
+    /**
+     * @brief Mark all pixels as changed and update the hardware
+     * 
+     * Normally show() only writes pixels that changed. Use this if the hardware state
+     * may have been changed outside of this library, such as after a NeoPixel strip
+     * was power cycled.
+     */
+    void showAll();
+
+    /**
+     * @brief Write one pixel to the hardware. Called from show() for each changed pixel.
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param color RGB color to display, with overrides and blinking already applied
+     */
+    virtual void showPixel(uint16_t /*n*/, uint32_t /*color*/) {};
+
+    /**
+     * @brief Write a batch of changed pixels to the hardware. Called from show().
+     * 
+     * @param pixels Pixel number of each color. From show() these are in increasing order, but as the 
+     * output of a StatusLedRK_Composite they can be in any order, such as reversed by addOutputMap().
+     * @param colorsArray RGB color to display for each pixel, with overrides, blinking, brightness, and gamma applied
+     * @param count Number of entries in pixels and colorsArray (1 to 32)
+     * 
+     * The default implementation calls showPixel() for each pixel. Subclasses that can write 
+     * several pixels more efficiently than one at a time, like StatusLedRK_Neopixel, override this.
+     */
+    virtual void showPixels(const uint16_t *pixels, const uint32_t *colorsArray, size_t count);
+
+    /**
+     * @brief Called from show() after showPixel() has been called for all changed pixels
+     * 
+     * Subclasses that buffer pixel writes (like NeoPixel) can push the buffer to the 
+     * hardware here. This is not called if no pixels changed.
+     */
+    virtual void showComplete() {};
+
+    /**
+     * @brief Called from showAll() before every pixel is written
+     * 
+     * Subclasses that skip writing values that have not changed, like StatusLedRK_RGB, 
+     * override this to forget what was last written so the hardware is fully refreshed.
      */
-    virtual void show() = 0;
+    virtual void invalidateCache() {};
 
     /**
      * @brief Subclasses can override this to do setup
@@ -113,6 +440,49 @@ public:
      */
 	void setColorStyle(uint16_t n, uint32_t color, uint8_t style, bool showNow = true);
 
+    /**
+     * @brief Set a pixel to display an animation pattern, such as PATTERN_BREATHE
+     *
+     * @param n Pixel number (0 is the first pixel)
+     * @param color RGB color used by keyframes that use keyframeLevel() instead of a fixed color
+     * @param pattern The pattern to display. This is not copied and must remain valid.
+     * @param showNow true to show the pixel immediately, or false to wait
+     *
+     * The pattern starts now. Setting the same pattern again does not restart it, the same
+     * way setting the same blink style does not restart blinking, but the color can be changed.
+     *
+     * While fading, the pixel is updated at most once per setPatternFrameMs(). Keyframes held
+     * with EASING_STEP and finished patterns are not checked until they change.
+     */
+    void setColorPattern(uint16_t n, uint32_t color, const Pattern *pattern, bool showNow = true);
+
+    /**
+     * @brief Set the minimum time between updates of a pixel that is fading
+     *
+     * @param ms Milliseconds between frames. Default: 20 (50 frames per second).
+     */
+    void setPatternFrameMs(uint16_t ms) { patternFrameMs = (ms > 0) ? ms : 1; };
+
+    /**
+     * @brief Set the minimum time between refreshes of the hardware
+     * 
+     * @param ms Minimum milliseconds between refreshes, or 0 to refresh on every change (the default)
+     * 
+     * When set, changes made less than ms after the last refresh are not shown immediately. 
+     * They're combined and shown by loop() (or the worker thread) when the interval ends, so a 
+     * burst of changes causes one refresh instead of one per change. This is useful with 
+     * NeoPixels, which disable interrupts during each refresh. To show a latency-critical 
+     * change right away, call show() after making it.
+     */
+    void setFrameLimitMs(uint16_t ms) { frameLimitMs = ms; lastShowMillis = clockMillis() - ms; };
+
+    /**
+     * @brief Gets the color for a keyframe that uses the pixel's color at a brightness level
+     *
+     * @param level 0 = off, 255 = the color passed to setColorPattern()
+     */
+    static constexpr uint32_t keyframeLevel(uint8_t level) { return KEYFRAME_LEVEL_FLAG | level; };
+
     /**
      * @brief Temporarily override the color and style of a pixel
      * 
@@ -121,185 +491,1678 @@ public:
      * @param style One of STYLE_ON, STYLE_BLINK_SLOW, STYLE_BLINK_FAST.
      * @param howLong How long to override the color in milliseconds.
      * @param clearOnChange If true and the color is set using setColor or setColorStyle, the override is removed.
+     * @param priority Layer priority, default 0. Higher priority overrides are shown over lower ones.
+     * 
+     * Each priority is a separate layer with its own expiration. Setting the same priority again
+     * replaces that layer; a howLong of 0 removes it. When the top layer ends, the next one down is
+     * shown if it hasn't expired yet. For example, a long low battery override at priority 0
+     * remains after a short button press override at priority 1 ends.
      */
-	void setOverrideStyle(uint16_t n, uint32_t color, uint8_t style, unsigned long howLong, bool clearOnChange = true);
+	void setOverrideStyle(uint16_t n, uint32_t color, uint8_t style, unsigned long howLong, bool clearOnChange = true, uint8_t priority = 0);
 
     /**
-     * @brief Get the number of pixels in the strip
+     * @brief Set all pixels to the same color and style
      * 
-     * @return size_t 
+     * @param color RGB color (uint32_t). See constants like COLOR_RED, below.
+     * @param style One of STYLE_ON, STYLE_BLINK_SLOW, STYLE_BLINK_FAST.
+     * @param showNow true to show the pixels immediately, or false to wait
+     * 
+     * The hardware is updated at most once, not once per pixel.
      */
-    size_t getNumPixels() const { return numPixels; };
-
-	static const uint32_t COLOR_BLACK = 0x000000;	//!< Off (0,0,0)
-	static const uint32_t COLOR_WHITE = 0xFFFFFF;	//!< Fully on white (255,255,255)
-	static const uint32_t COLOR_RED = 0xFF0000;	    //!< Red (255,0,0)
-	static const uint32_t COLOR_LIME = 0x00FF00;	//!< Light green (see also LED_GREEN which is fully on) (0,255,0)
-	static const uint32_t COLOR_BLUE = 0x0000FF;	//!< Blue (0,0,255)
-	static const uint32_t COLOR_YELLOW = 0xFFFF00;	//!< Yellow (255,255,0)
-	static const uint32_t COLOR_CYAN  = 0x00FFFF;	//!< Cyan (see also LED_TEAL which is a less-bright cyan) (0,255,255)
-	static const uint32_t COLOR_MAGENTA  = 0xFF00FF;	//!< Magenta (255,0,255)
-	static const uint32_t COLOR_SILVER = 0xC0C0C0;	//!< Less bright white (192,192,192)
-	static const uint32_t COLOR_GRAY = 0x808080;	//!< Even less bright white (128,128,128)
-	static const uint32_t COLOR_MAROON = 0x800000;	//!< Less bright magenta (128,0,0)
-	static const uint32_t COLOR_OLIVE = 0x808000;	//!< Less bright yellow (128,128,0)
-	static const uint32_t COLOR_GREEN = 0x008000;	//!< Less bright than lime (0,128,0)
-	static const uint32_t COLOR_PURPLE = 0x800080;	//!< Less bright than magenta (128,0,128)
-	static const uint32_t COLOR_TEAL = 0x008080;	//!< Less bright than cyan (0,128,128)
-	static const uint32_t COLOR_NAVY = 0x000080;	//!< Less bright than blue (0,0,128)
-
-	static const uint8_t STYLE_ON = 0; //!< On solid
-	static const uint8_t STYLE_BLINK_SLOW = 1; //!< Slowly blinking (1/2 Hz, 1000 ms per state) 
-	static const uint8_t STYLE_BLINK_FAST = 2; //!< Fast blinking (2 Hz, 250 ms per state)
-
-    static const unsigned long FAST_BLINK_MS = 250; //!< Milliseconds for STYLE_BLINK_FAST
-    static const unsigned long SLOW_BLINK_MS = 1000; //!< Milliseconds for STYLE_BLINK_SLOW
+    void fill(uint32_t color, uint8_t style = STYLE_ON, bool showNow = true);
 
-
-protected:
     /**
-     * @brief Used internally to see if there is an override change and the pixels need to be updated
+     * @brief Set a range of pixels to the same color and style
      * 
-     * @return true 
-     * @return false 
+     * @param first First pixel number to set (0 is the first pixel)
+     * @param count Number of pixels to set. The range is truncated at the end of the strip.
+     * @param color RGB color (uint32_t). See constants like COLOR_RED, below.
+     * @param style One of STYLE_ON, STYLE_BLINK_SLOW, STYLE_BLINK_FAST.
+     * @param showNow true to show the pixels immediately, or false to wait
+     * 
+     * The hardware is updated at most once, not once per pixel.
      */
-	bool checkForOverrideChange();
+    void setRange(uint16_t first, uint16_t count, uint32_t color, uint8_t style = STYLE_ON, bool showNow = true);
 
     /**
-     * @brief Used internally to update the loopCheckEnabled flag.
+     * @brief Set consecutive pixels from an array of colors
      * 
+     * @param first Pixel number for colorsArray[0] (0 is the first pixel)
+     * @param colorsArray Array of RGB colors
+     * @param count Number of entries in colorsArray. The range is truncated at the end of the strip.
+     * @param style One of STYLE_ON, STYLE_BLINK_SLOW, STYLE_BLINK_FAST. All pixels use the same style.
+     * @param showNow true to show the pixels immediately, or false to wait
+     * 
+     * The hardware is updated at most once, not once per pixel.
      */
-	void updateLoopCheckEnabled();
+    void setColors(uint16_t first, const uint32_t *colorsArray, size_t count, uint8_t style = STYLE_ON, bool showNow = true);
 
     /**
-     * This class cannot be copied
+     * @brief Temporarily override the color and style of a range of pixels
+     * 
+     * @param first First pixel number to override (0 is the first pixel)
+     * @param count Number of pixels. The range is truncated at the end of the strip.
+     * @param color RGB color (uint32_t). See constants like COLOR_RED, below.
+     * @param style One of STYLE_ON, STYLE_BLINK_SLOW, STYLE_BLINK_FAST.
+     * @param howLong How long to override the color in milliseconds.
+     * @param clearOnChange If true and the color is set using setColor or setColorStyle, the override is removed.
+     * @param priority Layer priority, default 0. See setOverrideStyle().
+     * 
+     * All of the overrides start at the same time so they expire together. The hardware
+     * is updated once.
      */
-    StatusLedRK(const StatusLedRK&) = delete;
+    void setOverrideRange(uint16_t first, uint16_t count, uint32_t color, uint8_t style, unsigned long howLong, bool clearOnChange = true, uint8_t priority = 0);
 
     /**
-     * This class cannot be copied
+     * @brief Set the table of status definitions used by setStatus()
+     * 
+     * @param table Array of status definitions. This is not copied and must remain valid.
+     * @param count Number of entries in table
      */
-    StatusLedRK& operator=(const StatusLedRK&) = delete;
-
-protected:
-    size_t numPixels = 0; //!< Number of pixels, set during construction.
-	PixelState *state = 0; //!< Array of PixelState structures, one per pixel. Allocated during setup().
-	LedOverride *overrides = 0; //!< Array of LedOverride structures, one per pixels. Allocated during setup().
-	bool loopCheckEnabled = false; //!< Internal flag used to determine whether the pixels should be checked on calls to loop.
-};
+    void setStatusTable(const StatusDefinition *table, size_t count) { statusTable = table; statusCount = count; };
 
-/**
- * @brief Class for status LED connected to PWM pins
- */
-class StatusLedRK_RGB : public StatusLedRK {
-public:
     /**
-     * @brief Structure that defines the pins used for red, green, and blue of an RGB LED
+     * @brief Set a pixel to a status from the table passed to setStatusTable()
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param statusId Index into the status table. Out of range values are ignored.
+     * @param showNow true to show the pixel immediately, or false to wait
+     * 
+     * If the status has a howLong, it's an override of that duration and priority (which is 
+     * always shown immediately, like setOverrideStyle()). Otherwise it sets the color, style, 
+     * or pattern of the pixel.
      */
-    typedef struct {
-        pin_t rPin; //!< Red pin
-        pin_t gPin; //!< Green pin
-        pin_t bPin; //!< Blue pin
-    } LedPins;
-
+    void setStatus(uint16_t n, uint16_t statusId, bool showNow = true);
 
     /**
-     * @brief Construct a new Status Led object
+     * @brief Get the name of a status from the status table
      * 
-     * @param numPixels Number of entries in pinsArray
-     * @param pinsArray The pinsArray is typically a const global structure. This is not copied! 
-     * @param isCommonAnode true for common anode (common pin connected to VCC) or false for common cathode (common pin connected to GND)
+     * @param statusId Index into the status table
+     * @return The name, or "" if statusId is out of range or the status does not have a name
      */
-	StatusLedRK_RGB(size_t numPixels, const LedPins *pinsArray, bool isCommonAnode = true);
+    const char *getStatusName(uint16_t statusId) const;
 
     /**
-     * @brief Destructor
+     * @brief Use a different time source instead of millis()
+     * 
+     * @param clock The clock to use, or NULL to use millis() (the default). This is not copied and must remain valid.
+     * 
+     * Set this before setup(). Each call to loop() reads the clock once and uses the same 
+     * time for every pixel. The worker thread still sleeps in real time, so use loop() 
+     * with a StatusLedRK_ManualClock.
      */
-	virtual ~StatusLedRK_RGB();
+    void setClock(StatusLedRK_Clock *clock) { this->clock = clock; };
 
     /**
-     * @brief Sets the pinMode of the LED pins. Called from setup().
+     * @brief Get the time the LEDs next need attention from loop()
+     * 
+     * @param when Filled in with the clock value (normally millis()) of the next blink change, 
+     * override expiration, pattern frame, or deferred refresh
+     * @return true if there is a next event, false if nothing will change until a method is called
      */
-	virtual void setup2();
+    bool getNextEventMillis(uint32_t &when);
 
     /**
-     * @brief Update the RGB LED to match the state in the StatusLedRK object
+     * @brief Get the number of milliseconds until the LEDs next need attention from loop()
+     * 
+     * @return Milliseconds until the next event, 0 if it's already due, or NO_EVENT if there isn't one
+     * 
+     * This can be used as the sleep duration on battery powered devices, for example:
+     * 
+     * ```
+     * unsigned long ms = statusLed.getMillisUntilNextEvent();
+     * if (ms != StatusLedRK::NO_EVENT) {
+     *     config.duration(ms);
+     * }
+     * System.sleep(config);
+     * statusLed.resync();
+     * ```
      */
-	virtual void show();
-
-
-protected:
-    const LedPins *pinsArray; //!< Definition of the GPIO used for the RGB LED PWM pins
-    bool isCommonAnode = true;  //!< true for common anode (common pin connected to VCC) or false for common cathode (common pin connected to GND)
-};
-
-#ifdef PARTICLE_NEOPIXEL_H
-// Library: neopixel
-// https://github.com/technobly/Particle-NeoPixel
+    unsigned long getMillisUntilNextEvent();
 
-class StatusLedRK_Neopixel : public StatusLedRK {
-public:
     /**
-     * @brief Construct a new StatusLedRK_StatusLedRK_NeopixelRGB object
+     * @brief Bring the LEDs up to date after sleeping or not calling loop() for a while
      * 
-     * @param strip 
+     * All overdue overrides are expired and blinking pixels are set to the phase they would 
+     * have had if loop() had been called the whole time, in one pass, and then shown. If the 
+     * LED hardware lost its state during sleep, call showAll() as well.
      */
-	StatusLedRK_Neopixel(Adafruit_NeoPixel *strip) : StatusLedRK(strip->numPixels()), strip(strip) {
-    }
+    void resync();
 
     /**
-     * @brief Destructor
+     * @brief Synchronize blinking of all pixels to a shared clock
+     * 
+     * @param enable true to enable synchronized blinking, false to use per-pixel blink timing (the default)
+     * 
+     * When enabled, the on/off phase of STYLE_BLINK_SLOW and STYLE_BLINK_FAST is computed
+     * from the time since this call, so all pixels with the same style blink in phase and
+     * do not drift when loop() is called late. No per-pixel blink timing is kept, and
+     * loop() checks for a blink change with two comparisons.
+     * 
+     * When disabled, each pixel starts blinking when it's set to a blinking style.
      */
-	virtual ~StatusLedRK_Neopixel() {        
-    }
+    void setBlinkSync(bool enable);
 
     /**
-     * @brief Update the Neopixel strip to match the state in the StatusLedRK object
+     * @brief Returns true if synchronized blinking is enabled
      */
-	virtual void show() {
-        for(uint16_t ii = 0; ii < strip->numPixels(); ii++) {
-            strip->setPixelColor(ii, getColorWithOverride(ii));
+    bool getBlinkSync() const { return blinkSync; };
+
+    /**
+     * @brief Start a group of changes that are shown together
+     * 
+     * Until the matching commit(), calls to setColor(), setColorStyle(), setOverrideStyle() 
+     * and the range functions do not update the hardware. Calls can be nested; only the 
+     * outermost commit() takes effect.
+     * 
+     * When using startThread(), the object is locked until commit().
+     */
+    void beginUpdate();
+
+    /**
+     * @brief End a group of changes started with beginUpdate()
+     * 
+     * If any of the changes requested that the pixels be shown, show() is called once.
+     */
+    void commit();
+
+    /**
+     * @brief Set the brightness of all pixels
+     *
+     * @param brightness 0 = off, 255 = full brightness (the default)
+     *
+     * This is applied when the pixels are written to the hardware, so the colors that were
+     * set (and getColorWithOverride()) are not changed. All pixels are updated.
+     */
+    void setBrightness(uint8_t brightness);
+
+    /**
+     * @brief Get the brightness set using setBrightness()
+     */
+    uint8_t getBrightness() const { return brightness; };
+
+    /**
+     * @brief Set the gamma correction for all color channels
+     *
+     * @param gamma Gamma exponent. 1.0 is no correction (the default); 2.2 to 2.8 is typical for LEDs.
+     *
+     * Without gamma correction, dim colors such as COLOR_NAVY look much brighter than expected.
+     * All pixels are updated.
+     */
+    void setGamma(float gamma) { setGamma(gamma, gamma, gamma); };
+
+    /**
+     * @brief Set the gamma correction for each color channel
+     *
+     * @param red Gamma exponent for red
+     * @param green Gamma exponent for green
+     * @param blue Gamma exponent for blue
+     */
+    void setGamma(float red, float green, float blue);
+
+    /**
+     * @brief Set the brightness of a single pixel
+     *
+     * @param n Pixel number (0 is the first pixel)
+     * @param brightness 0 = off, 255 = full brightness (the default)
+     * @param showNow true to show the pixel immediately, or false to wait
+     *
+     * This is combined with setBrightness(). The first call allocates one byte per pixel
+     * (except with StatusLedRK_Static).
+     */
+    void setPixelBrightness(uint16_t n, uint8_t brightness, bool showNow = true);
+
+    /**
+     * @brief Get the number of pixels in the strip
+     * 
+     * @return size_t 
+     */
+    size_t getNumPixels() const { return numPixels; };
+
+    /**
+     * @brief Get the number of bytes of heap currently used for pixel state
+     * 
+     * @return size_t Number of bytes
+     * 
+     * This includes the per-pixel arrays allocated during setup() and the override
+     * and scheduler pools, which grow as needed. It's 0 for StatusLedRK_Static.
+     */
+    size_t getMemoryUsage() const;
+
+    /**
+     * @brief Get the number of bytes for a snapshot of a number of pixels and overrides
+     * 
+     * @param numPixels Number of pixels
+     * @param numOverrides Maximum number of override layers to save
+     * 
+     * This can be used to size a retained buffer at compile time, for example:
+     * 
+     * ```
+     * retained uint8_t ledSnapshot[StatusLedRK::snapshotSize(8, 4)];
+     * ```
+     */
+    static constexpr size_t snapshotSize(size_t numPixels, size_t numOverrides) {
+        return sizeof(SnapshotHeader) + numPixels * 3 + (numPixels + 3) / 4 + numOverrides * sizeof(SnapshotOverride);
+    }
+
+    /**
+     * @brief Get the number of bytes needed by saveSnapshot() for the current state
+     */
+    size_t getSnapshotSize();
+
+    /**
+     * @brief Save the color and style of every pixel and the active overrides to a buffer
+     * 
+     * @param buf Buffer to save to, typically in retained memory
+     * @param bufSize Size of buf in bytes
+     * @return Number of bytes saved, or 0 if buf is too small for the pixels or setup() has not been called
+     * 
+     * Overrides are saved with the time they have left. If buf is too small for all of the 
+     * overrides, the ones that fit are saved. Pixels displaying a pattern are saved as solid 
+     * (the pattern is not saved, since it's not valid after a firmware update).
+     */
+    size_t saveSnapshot(void *buf, size_t bufSize);
+
+    /**
+     * @brief Restore the state saved by saveSnapshot(). Call after setup().
+     * 
+     * @param buf Buffer containing the snapshot
+     * @param bufSize Size of buf in bytes
+     * @return true if restored, or false if the snapshot is not valid (the state is not changed)
+     * 
+     * The snapshot is checked for the magic number, version, number of pixels, and checksum 
+     * so uninitialized retained memory is rejected. The colors and styles are copied directly.
+     * Blinking pixels restart blinking (on), and overrides run for the time they had left.
+     */
+    bool restoreSnapshot(const void *buf, size_t bufSize);
+
+    /**
+     * @brief Get a copy of the performance counters
+     * 
+     * The counters are only kept if STATUSLEDRK_ENABLE_STATS is 1. Otherwise all values are 0.
+     */
+    Stats getStats();
+
+    /**
+     * @brief Set all of the performance counters to 0
+     */
+    void resetStats();
+
+    /**
+     * @brief Write the performance counters to the log using Log.info()
+     */
+    void logStats();
+
+	static const uint32_t COLOR_BLACK = 0x000000;	//!< Off (0,0,0)
+	static const uint32_t COLOR_WHITE = 0xFFFFFF;	//!< Fully on white (255,255,255)
+	static const uint32_t COLOR_RED = 0xFF0000;	    //!< Red (255,0,0)
+	static const uint32_t COLOR_LIME = 0x00FF00;	//!< Light green (see also LED_GREEN which is fully on) (0,255,0)
+	static const uint32_t COLOR_BLUE = 0x0000FF;	//!< Blue (0,0,255)
+	static const uint32_t COLOR_YELLOW = 0xFFFF00;	//!< Yellow (255,255,0)
+	static const uint32_t COLOR_CYAN  = 0x00FFFF;	//!< Cyan (see also LED_TEAL which is a less-bright cyan) (0,255,255)
+	static const uint32_t COLOR_MAGENTA  = 0xFF00FF;	//!< Magenta (255,0,255)
+	static const uint32_t COLOR_SILVER = 0xC0C0C0;	//!< Less bright white (192,192,192)
+	static const uint32_t COLOR_GRAY = 0x808080;	//!< Even less bright white (128,128,128)
+	static const uint32_t COLOR_MAROON = 0x800000;	//!< Less bright magenta (128,0,0)
+	static const uint32_t COLOR_OLIVE = 0x808000;	//!< Less bright yellow (128,128,0)
+	static const uint32_t COLOR_GREEN = 0x008000;	//!< Less bright than lime (0,128,0)
+	static const uint32_t COLOR_PURPLE = 0x800080;	//!< Less bright than magenta (128,0,128)
+	static const uint32_t COLOR_TEAL = 0x008080;	//!< Less bright than cyan (0,128,128)
+	static const uint32_t COLOR_NAVY = 0x000080;	//!< Less bright than blue (0,0,128)
+
+	static const uint8_t STYLE_ON = 0; //!< On solid
+	static const uint8_t STYLE_BLINK_SLOW = 1; //!< Slowly blinking (1/2 Hz, 1000 ms per state) 
+	static const uint8_t STYLE_BLINK_FAST = 2; //!< Fast blinking (2 Hz, 250 ms per state)
+	static const uint8_t STYLE_PATTERN = 3; //!< Animation pattern. Set using setColorPattern(), not setColorStyle().
+
+    static const unsigned long FAST_BLINK_MS = 250; //!< Milliseconds for STYLE_BLINK_FAST
+    static const unsigned long SLOW_BLINK_MS = 1000; //!< Milliseconds for STYLE_BLINK_SLOW
+    static const unsigned long NO_EVENT = 0xffffffff; //!< Returned by getMillisUntilNextEvent() if nothing is scheduled
+
+    static const uint32_t SNAPSHOT_MAGIC = 0x4c656453; //!< Magic number in SnapshotHeader
+    static const uint16_t SNAPSHOT_VERSION = 1; //!< Version of the snapshot format in SnapshotHeader
+
+    static const uint8_t EASING_STEP = 0; //!< Hold the keyframe color, then change to the next one
+    static const uint8_t EASING_LINEAR = 1; //!< Fade at a constant rate
+    static const uint8_t EASING_SINE = 2; //!< Fade slowly at the start and end (half cosine), good for breathing
+    static const uint8_t EASING_IN = 3; //!< Fade slowly at the start (quadratic)
+    static const uint8_t EASING_OUT = 4; //!< Fade slowly at the end (quadratic)
+
+    static const uint32_t KEYFRAME_LEVEL_FLAG = 0x01000000; //!< Set in Keyframe color when the low 8 bits are a level. See keyframeLevel().
+
+    static const Pattern PATTERN_BREATHE; //!< Fade between off and the pixel color, 2 seconds per breath
+    static const Pattern PATTERN_FADE_IN; //!< Fade from off to the pixel color over 1 second, then stay on
+    static const Pattern PATTERN_FADE_OUT; //!< Fade from the pixel color to off over 1 second, then stay off
+
+
+protected:
+    /**
+     * @brief Used internally to see if there is an override change and the pixels need to be updated
+     * 
+     * @return true 
+     * @return false 
+     * 
+     * This processes all blink toggles and override expiries that are due, not just overrides.
+     */
+	bool checkForOverrideChange();
+
+    /**
+     * @brief Used internally to process the pixels whose deadline has passed
+     * 
+     * @param now The millis() value to use as the current time
+     * @param catchUp true to keep the blink phase as if every missed blink change had happened, 
+     * false to restart the blink period at now (normal loop() behavior)
+     * @return true if any pixel changed and show() needs to be called
+     * 
+     * Only the pixels at the top of the deadline heap are touched, so this is O(1) when
+     * nothing is due and O(k log n) when k pixels are due.
+     */
+    bool processDueEvents(uint32_t now, bool catchUp = false);
+
+    /**
+     * @brief Used internally to apply the blink changes that are due since lastTime
+     * 
+     * @param lastTime The time of the last blink change, updated to the time of the last one applied
+     * @param blinkMs Milliseconds per on or off state
+     * @param now The millis() value to use as the current time
+     * @param catchUp true to apply every missed change, false to apply one at now
+     * @return true if the blink state flips (an odd number of changes)
+     */
+    static bool advanceBlink(uint32_t &lastTime, unsigned long blinkMs, uint32_t now, bool catchUp);
+
+    /**
+     * @brief Used internally to compute the synchronized blink phase and next toggle times
+     * 
+     * @param now The millis() value to use as the current time
+     */
+    void updateSyncPhase(uint32_t now);
+
+    /**
+     * @brief Used internally to mark all pixels that are displaying the specified blink style as changed
+     * 
+     * @param style STYLE_BLINK_SLOW or STYLE_BLINK_FAST
+     */
+    void markStyleDirty(uint8_t style);
+
+    /**
+     * @brief Returns true if the synchronized blink for a style is in the on part of blinking
+     * 
+     * @param style STYLE_BLINK_SLOW or STYLE_BLINK_FAST
+     */
+    bool isSyncBlinkOn(uint8_t style) const { return (style == STYLE_BLINK_FAST) ? syncFastOn : syncSlowOn; };
+
+    /**
+     * @brief Used internally to get the color of a pixel, taking into account overrides
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * 
+     * This is the same as getColorWithOverride() but does not lock. It's used by show().
+     */
+    uint32_t resolveColor(uint16_t n) const;
+
+    /**
+     * @brief Used internally to get the time the next blink change, override expiration, or deferred refresh is due
+     * 
+     * @param when Filled in with the millis() value of the next event
+     * @return true if there is a next event, false if nothing is blinking, overridden, or waiting to be shown
+     */
+    bool getNextDeadline(uint32_t &when) const;
+
+    /**
+     * @brief Used internally to wake the worker thread so it recalculates its sleep time
+     */
+    void wakeThread();
+
+    /**
+     * @brief Worker thread function used by startThread()
+     */
+    os_thread_return_t threadFunction();
+
+    /**
+     * @brief Used internally to get the current time from the clock set with setClock(), or millis()
+     */
+    uint32_t clockMillis() const { return clock ? clock->getMillis() : (uint32_t) millis(); };
+
+    /**
+     * @brief RGB.onChange() handler used by startSystemMirror()
+     * 
+     * This may be called from the system LED update at any time, so it only saves the color
+     * and wakes the worker thread.
+     */
+    void systemLedChanged(uint8_t r, uint8_t g, uint8_t b);
+
+    /**
+     * @brief Used internally to set the mirror pixel to the last system LED color saved by systemLedChanged()
+     * 
+     * Only the non-override state is set, so overrides of the pixel stay in effect.
+     * 
+     * @return true if the color of the mirror pixel changed
+     */
+    bool applySystemMirror();
+
+    /**
+     * @brief Used internally to call show(), or defer it until commit() if in a transaction
+     * 
+     * If setFrameLimitMs() is set, the show may also be deferred until the end of the frame interval.
+     */
+    void requestShow();
+
+    /**
+     * @brief Used internally to call show() if the frame interval has ended, otherwise mark it as deferred
+     * 
+     * @param now The millis() value
+     */
+    void showFrame(uint32_t now);
+
+    /**
+     * @brief Used internally to set or clear one override layer of a single pixel
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param color RGB color (uint32_t)
+     * @param style One of STYLE_ON, STYLE_BLINK_SLOW, STYLE_BLINK_FAST. Any other value is treated as STYLE_ON.
+     * @param howLong How long to override the color in milliseconds. 0 removes the override.
+     * @param clearOnChange If true and the color is set using setColor or setColorStyle, the override is removed.
+     * @param priority Layer priority
+     * @param now The millis() value to use as the start time
+     * 
+     * This does not update loopCheckEnabled or show the pixel.
+     */
+    void applyOverride(uint16_t n, uint32_t color, uint8_t style, unsigned long howLong, bool clearOnChange, uint8_t priority, uint32_t now);
+
+    /**
+     * @brief Used internally to set the color, style, and pattern of the non-override state of a pixel
+     *
+     * @param n Pixel number (0 is the first pixel)
+     * @param color RGB color (uint32_t)
+     * @param style One of STYLE_ON, STYLE_BLINK_SLOW, STYLE_BLINK_FAST, STYLE_PATTERN. Any other value,
+     * or STYLE_PATTERN without a pattern, is treated as STYLE_ON.
+     * @param pattern Pattern to display if style is STYLE_PATTERN, otherwise ignored
+     * @param clearOverrides true to remove the override layers that have clearOnChange set. The 
+     * system LED mirror passes false, as it's not a change made by the application.
+     *
+     * This does not update loopCheckEnabled or show the pixel.
+     */
+    void applyColorStyle(uint16_t n, uint32_t color, uint8_t style, const Pattern *pattern, bool clearOverrides = true);
+
+    /**
+     * @brief Used internally to compute the color of a pattern at a specific time
+     *
+     * @param ps The pattern state of the pixel
+     * @param now The millis() value to use as the current time
+     * @param color Filled in with the RGB color
+     * @param nextMillis Filled in with the millis() value when the color next changes
+     * @return true if the color will change, false if the pattern is finished
+     *
+     * Interpolation is done in fixed point with an easing lookup table.
+     */
+    bool evaluatePattern(const PatternState *ps, uint32_t now, uint32_t &color, uint32_t &nextMillis) const;
+
+    /**
+     * @brief Used internally to compute the current frame of a pattern and mark the pixel dirty if it changed
+     *
+     * @param ps The pattern state of the pixel
+     * @param now The millis() value to use as the current time
+     * @return true if the color of the frame changed
+     */
+    bool updatePatternFrame(PatternState *ps, uint32_t now);
+
+    /**
+     * @brief Returns true if the style is STYLE_BLINK_SLOW or STYLE_BLINK_FAST
+     */
+    static bool isBlinkStyle(uint8_t style) { return style == STYLE_BLINK_SLOW || style == STYLE_BLINK_FAST; };
+
+    /**
+     * @brief Returns true if blink toggles are per-pixel deadlines in the heap
+     * 
+     * They're not in blinkSync mode (shared phase) or with hardwareBlink (done by the LED driver).
+     */
+    bool hasBlinkDeadlines() const { return !blinkSync && !hardwareBlink; };
+
+    /**
+     * @brief Used internally to get the style of a pixel, taking into account overrides
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * 
+     * Subclasses that set hardwareBlink use this from showPixel() to find out if the pixel is blinking.
+     */
+    uint8_t resolveStyle(uint16_t n) const { return getBit(overrideBits, n) ? findOverride(n)->state.style : getStateStyle(n); };
+
+    /**
+     * @brief Used internally to compute the next deadline of a pixel and update the heap
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param now The millis() value to use as the current time
+     * @param baseLastTime The last blink change time of the non-override state. Ignored if overridden.
+     * 
+     * Call this whenever the style or override of a pixel changes. Pixels that are solid 
+     * and not overridden are removed from the heap.
+     */
+    void schedulePixel(uint16_t n, uint32_t now, uint32_t baseLastTime);
+
+    /**
+     * @brief Used internally to get the last blink change time of the non-override state of a pixel
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param now The millis() value to use as the current time
+     * 
+     * There is no per-pixel timestamp. For a blinking pixel it's derived from its deadline
+     * in the heap, or saved in the override while overridden. 
+     */
+    uint32_t getBaseLastTime(uint16_t n, uint32_t now) const;
+
+    /**
+     * @brief Used internally to make sure the heap can hold count entries
+     * 
+     * @param count Number of entries required
+     * @return true if there is room, false if out of memory
+     */
+    bool reserveHeap(size_t count);
+
+    /**
+     * @brief Used internally to find the override that is shown for a pixel (the top layer)
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @return LedOverride* or NULL if the pixel does not have an override
+     * 
+     * The other layers of the pixel follow it in the overrides array.
+     */
+    LedOverride *findOverride(uint16_t n) const;
+
+    /**
+     * @brief Used internally to find the override layer of a pixel with a specific priority
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param priority Layer priority
+     * @return LedOverride* or NULL if the pixel does not have an override with that priority
+     */
+    LedOverride *findOverrideLayer(uint16_t n, uint8_t priority) const;
+
+    /**
+     * @brief Used internally to add an override layer for a pixel that does not have that priority
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param priority Layer priority
+     * @return LedOverride* or NULL if out of memory. Only the pixel and priority fields are initialized.
+     */
+    LedOverride *insertOverride(uint16_t n, uint8_t priority);
+
+    /**
+     * @brief Used internally to remove an override layer
+     * 
+     * @param ov Pointer returned from findOverride() or findOverrideLayer(). It's no longer valid after this call.
+     */
+    void removeOverride(LedOverride *ov);
+
+    /**
+     * @brief Used internally to remove the expired or clearOnChange override layers of a pixel
+     * 
+     * @param n Pixel number (0 is the first pixel). Must have an override.
+     * @param now The millis() value to use as the current time
+     * @param clearOnChange true to remove layers with clearOnChange set, false to remove expired layers
+     * @return true if the top layer was removed, so what is shown changed
+     * 
+     * If a lower layer becomes the top layer, its blinking restarts.
+     */
+    bool removeOverrideLayers(uint16_t n, uint32_t now, bool clearOnChange);
+
+    /**
+     * @brief Used internally to set the saved base blink time in all override layers of a pixel
+     * 
+     * @param n Pixel number (0 is the first pixel). Must have an override.
+     * @param baseLastTime The last blink change time of the non-override state
+     */
+    void setOverrideBaseLastTime(uint16_t n, uint32_t baseLastTime);
+
+    /**
+     * @brief Used internally to make sure the override pool can hold count entries
+     * 
+     * @param count Number of entries required
+     * @return true if there is room, false if out of memory
+     */
+    bool reserveOverrides(size_t count);
+
+    /**
+     * @brief Used internally to find the pattern state for a pixel
+     *
+     * @param n Pixel number (0 is the first pixel)
+     * @return PatternState* or NULL if the pixel is not displaying a pattern
+     */
+    PatternState *findPattern(uint16_t n) const;
+
+    /**
+     * @brief Used internally to add a pattern state for a pixel that does not have one
+     *
+     * @param n Pixel number (0 is the first pixel)
+     * @return PatternState* or NULL if out of memory. Only the pixel field is initialized.
+     */
+    PatternState *insertPattern(uint16_t n);
+
+    /**
+     * @brief Used internally to remove a pattern state
+     *
+     * @param ps Pointer returned from findPattern(). It's no longer valid after this call.
+     */
+    void removePattern(PatternState *ps);
+
+    /**
+     * @brief Used internally to make sure the pattern pool can hold count entries
+     *
+     * @param count Number of entries required
+     * @return true if there is room, false if out of memory
+     */
+    bool reservePatterns(size_t count);
+
+    /**
+     * @brief Used internally to remove a pixel from the deadline heap
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     */
+    void heapRemove(uint16_t n);
+
+    /**
+     * @brief Used internally to move a heap entry toward the root until the heap is valid
+     * 
+     * @param index Index into heap
+     */
+    void heapSiftUp(size_t index);
+
+    /**
+     * @brief Used internally to move a heap entry toward the leaves until the heap is valid
+     * 
+     * @param index Index into heap
+     */
+    void heapSiftDown(size_t index);
+
+    /**
+     * @brief Used internally to swap two heap entries and update heapPos
+     */
+    void heapSwap(size_t a, size_t b);
+
+    /**
+     * @brief Compare two millis() values, handling rollover
+     * 
+     * @return true if a is before b
+     */
+    static bool isBefore(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; };
+
+    /**
+     * @brief Get the color of the non-override state of a pixel
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     */
+    uint32_t getStateColor(uint16_t n) const { 
+        const uint8_t *p = &colors[n * 3];
+        return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | (uint32_t)p[2];
+    };
+
+    /**
+     * @brief Set the color of the non-override state of a pixel
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param color RGB color. Only the low 24 bits are stored.
+     */
+    void setStateColor(uint16_t n, uint32_t color) { 
+        uint8_t *p = &colors[n * 3];
+        p[0] = (uint8_t)(color >> 16);
+        p[1] = (uint8_t)(color >> 8);
+        p[2] = (uint8_t)color;
+    };
+
+    /**
+     * @brief Get the style of the non-override state of a pixel
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     */
+    uint8_t getStateStyle(uint16_t n) const { return (styles[n / 4] >> ((n % 4) * 2)) & 0x3; };
+
+    /**
+     * @brief Set the style of the non-override state of a pixel
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param style One of STYLE_ON, STYLE_BLINK_SLOW, STYLE_BLINK_FAST, STYLE_PATTERN.
+     */
+    void setStateStyle(uint16_t n, uint8_t style) { 
+        uint8_t shift = (n % 4) * 2;
+        styles[n / 4] = (styles[n / 4] & ~(0x3 << shift)) | ((style & 0x3) << shift);
+    };
+
+    /**
+     * @brief Get the blink period in milliseconds for a blinking style
+     * 
+     * @param style STYLE_BLINK_SLOW or STYLE_BLINK_FAST
+     */
+    static unsigned long getBlinkMs(uint8_t style) { return (style == STYLE_BLINK_FAST) ? FAST_BLINK_MS : SLOW_BLINK_MS; };
+
+    /**
+     * @brief Get the last blink change time for a blink that starts (turns on) at a point in time
+     * 
+     * @param style STYLE_BLINK_SLOW or STYLE_BLINK_FAST
+     * @param start The millis() value when the blink starts
+     * 
+     * The first change is due at start, and resync() counts the changes missed since start.
+     */
+    static uint32_t getBlinkStartTime(uint8_t style, uint32_t start) { return start - getBlinkMs(style); };
+
+    /**
+     * @brief Get a bit from a bit array of 32 pixels per word
+     */
+    static bool getBit(const uint32_t *bits, uint16_t n) { return (bits[n / 32] & (1ul << (n % 32))) != 0; };
+
+    /**
+     * @brief Set a bit in a bit array of 32 pixels per word
+     */
+    static void setBit(uint32_t *bits, uint16_t n) { bits[n / 32] |= (1ul << (n % 32)); };
+
+    /**
+     * @brief Clear a bit in a bit array of 32 pixels per word
+     */
+    static void clearBit(uint32_t *bits, uint16_t n) { bits[n / 32] &= ~(1ul << (n % 32)); };
+
+    /**
+     * @brief Invert a bit in a bit array of 32 pixels per word
+     */
+    static void flipBit(uint32_t *bits, uint16_t n) { bits[n / 32] ^= (1ul << (n % 32)); };
+
+    /**
+     * @brief Used internally to update the loopCheckEnabled flag.
+     * 
+     * This is constant time; it uses overrideCount and blinkingCount, which are updated
+     * as pixels change style and overrides start and end.
+     */
+	void updateLoopCheckEnabled();
+
+    /**
+     * @brief Mark a pixel as changed so the next show() writes it to the hardware
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     */
+    void markDirty(uint16_t n) { 
+        setBit(dirty, n); 
+        anyDirty = true; 
+    }
+
+    /**
+     * @brief Mark all pixels as changed so the next show() writes all of them
+     */
+    void markAllDirty();
+
+    /**
+     * @brief Returns true if the pixel has changed since the last show()
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     */
+    bool isDirty(uint16_t n) const { return getBit(dirty, n); };
+
+    /**
+     * @brief Clear all of the pixel changed flags. Done by show() after writing the changed pixels.
+     */
+    void clearDirty();
+
+    /**
+     * @brief Used internally to apply brightness and gamma to colors before they are written to the hardware
+     *
+     * @param pixels Pixel number of each color
+     * @param colorsArray RGB colors, converted in place
+     * @param count Number of entries in pixels and colorsArray
+     *
+     * Each channel is one lookup in outputTable. This is only called if correctOutput is set.
+     */
+    void correctColors(const uint16_t *pixels, uint32_t *colorsArray, size_t count) const;
+
+    /**
+     * @brief Used internally to compute outputTable from the gamma and brightness settings
+     *
+     * @return true if successful, false if out of memory
+     */
+    bool buildOutputTable();
+
+    /**
+     * @brief Used internally by StatusLedRK_Static to supply the storage of a subclass output cache
+     * 
+     * @param cache OUTPUT_CACHE_BYTES_PER_PIXEL bytes per pixel
+     * 
+     * Subclasses with an output cache, like StatusLedRK_RGB, hide this with their own version.
+     */
+    void setOutputCache(uint8_t * /*cache*/) {};
+
+    static const size_t OUTPUT_CACHE_BYTES_PER_PIXEL = 0; //!< Bytes per pixel of the output cache of a subclass, 0 if it has none
+
+    /**
+     * This class cannot be copied
+     */
+    StatusLedRK(const StatusLedRK&) = delete;
+
+    /**
+     * This class cannot be copied
+     */
+    StatusLedRK& operator=(const StatusLedRK&) = delete;
+
+protected:
+    size_t numPixels = 0; //!< Number of pixels, set during construction.
+    uint8_t *colors = 0; //!< Packed 24-bit RGB color of each pixel, 3 bytes per pixel. Allocated during setup().
+    uint8_t *styles = 0; //!< Style of each pixel, 2 bits per pixel. Allocated during setup().
+    uint32_t *blinkBits = 0; //!< Bit array of whether the blink is on (1) or off (0). Allocated during setup().
+    uint32_t *overrideBits = 0; //!< Bit array of pixels that have an entry in overrides. Allocated during setup().
+	LedOverride *overrides = 0; //!< Active overrides sorted by pixel number. Allocated as needed.
+    size_t overridesCapacity = 0; //!< Number of entries allocated in overrides
+    PatternState *patterns = 0; //!< Pattern state of pixels using STYLE_PATTERN, sorted by pixel number. Allocated as needed.
+    size_t patternCount = 0; //!< Number of entries in patterns
+    size_t patternsCapacity = 0; //!< Number of entries allocated in patterns
+    uint16_t patternFrameMs = 20; //!< Minimum milliseconds between frames of a fading pattern
+    const StatusDefinition *statusTable = 0; //!< Table of status definitions for setStatus(), not copied
+    size_t statusCount = 0; //!< Number of entries in statusTable
+	bool loopCheckEnabled = false; //!< Internal flag used to determine whether the pixels should be checked on calls to loop.
+    uint32_t *dirty = 0; //!< Bit array of pixels that changed since the last show(), 32 pixels per word. Allocated during setup().
+    bool anyDirty = false; //!< True if any bit in dirty is set
+    Deadline *heap = 0; //!< Min-heap of pixel deadlines, earliest at heap[0]. Allocated as needed.
+    uint16_t *heapPos = 0; //!< Index into heap for each pixel, or HEAP_POS_NONE. Allocated during setup().
+    size_t heapSize = 0; //!< Number of entries in heap
+    size_t heapCapacity = 0; //!< Number of entries allocated in heap
+    size_t overrideCount = 0; //!< Number of active override layers (entries in overrides)
+    size_t blinkingCount = 0; //!< Number of pixels whose (non-override) style is blinking or a pattern
+    bool ownsStorage = true; //!< true if the arrays are allocated on the heap by this class, false if provided by a subclass
+    uint16_t updateDepth = 0; //!< Nesting level of beginUpdate() calls
+    uint16_t updateLockCount = 0; //!< Number of the nested beginUpdate() calls that locked the mutex
+    bool showPending = false; //!< A show was requested during beginUpdate()
+    StatusLedRK_Clock *clock = 0; //!< Time source set by setClock(), or NULL to use millis()
+    uint16_t frameLimitMs = 0; //!< Minimum milliseconds between refreshes, 0 for no limit
+    bool mirrorEnabled = false; //!< startSystemMirror() has been called
+    uint16_t mirrorPixel = 0; //!< Pixel that mirrors the system LED, if mirrorEnabled
+    std::atomic<uint32_t> mirrorColor{0}; //!< Last system LED color with MIRROR_PENDING set, or 0 if already applied
+    uint32_t lastShowMillis = 0; //!< millis() value of the last refresh, if frameLimitMs is set
+    bool frameDeferred = false; //!< A show was requested too soon after the last refresh
+    bool blinkSync = false; //!< Blink phase is computed from blinkEpoch instead of per pixel
+    bool hardwareBlink = false; //!< Set by subclasses whose hardware blinks by itself. Blinking pixels are shown in their on color and never toggled.
+    bool syncSlowOn = true; //!< In blinkSync mode, whether STYLE_BLINK_SLOW is on
+    bool syncFastOn = true; //!< In blinkSync mode, whether STYLE_BLINK_FAST is on
+    uint32_t blinkEpoch = 0; //!< In blinkSync mode, millis() value when blinking started
+    uint32_t nextSlowToggle = 0; //!< In blinkSync mode, millis() value of the next STYLE_BLINK_SLOW change
+    uint32_t nextFastToggle = 0; //!< In blinkSync mode, millis() value of the next STYLE_BLINK_FAST change
+    os_mutex_recursive_t mutex = 0; //!< Recursive mutex, created by startThread()
+    os_queue_t threadQueue = 0; //!< Queue used to wake the worker thread
+    Thread *thread = 0; //!< Worker thread, created by startThread()
+    bool threadStop = false; //!< Set (while locked) to stop the worker thread
+#if STATUSLEDRK_ENABLE_STATS
+    Stats stats = {}; //!< Performance counters, see getStats()
+#endif
+    uint8_t *outputTable = 0; //!< Brightness and gamma lookup table, 256 entries each for red, green, and blue. Allocated when first used.
+    uint8_t *pixelBrightness = 0; //!< Brightness of each pixel. Allocated by the first setPixelBrightness().
+    bool usePixelBrightness = false; //!< true if setPixelBrightness() has been called
+    bool correctOutput = false; //!< true if brightness or gamma is set, so correctColors() is needed
+    uint8_t brightness = 255; //!< Brightness of all pixels, 255 = full
+    float gammaRed = 1.0; //!< Gamma exponent for red
+    float gammaGreen = 1.0; //!< Gamma exponent for green
+    float gammaBlue = 1.0; //!< Gamma exponent for blue
+
+    static const uint16_t HEAP_POS_NONE = 0xffff; //!< Value in heapPos when the pixel has no deadline
+    static const uint32_t MIRROR_PENDING = 0x01000000; //!< Set in mirrorColor when the system LED color has not been applied yet
+
+    friend class StatusLedRK_Composite;
+    friend class StatusLedRK_StreamDecoder;
+};
+
+/**
+ * @brief Wrapper that gives any StatusLedRK subclass fixed-size storage instead of heap allocation
+ * 
+ * @tparam Base The StatusLedRK subclass, such as StatusLedRK_RGB or StatusLedRK_Neopixel
+ * @tparam N Maximum number of pixels. The storage is sized for this at compile time.
+ * @tparam MAX_OVERRIDES Maximum number of simultaneous override layers. Defaults to 8 (or N, if smaller).
+ * @tparam MAX_PATTERNS Maximum number of pixels displaying a pattern at once. Defaults to 4 (or N, if smaller).
+ * @tparam OUTPUT_CORRECTION true to reserve storage for setGamma(), setBrightness() and setPixelBrightness(),
+ * 768 + N bytes. Defaults to false, and those calls are ignored.
+ * 
+ * The constructor arguments are the same as Base. For example:
+ * 
+ * ```
+ * StatusLedRK_Static<StatusLedRK_Neopixel, 60> statusLed(&strip);
+ * ```
+ * 
+ * The pixels use about 14 bytes each, plus 32 bytes per override and 20 bytes per pattern
+ * (32-bit platforms). Set MAX_OVERRIDES and MAX_PATTERNS to what the application actually uses
+ * at the same time; for example, MAX_PATTERNS can be 0 if patterns are not used.
+ * 
+ * Nothing is allocated from the heap, in setup() or later, including the output cache of 
+ * StatusLedRK_RGB. If more than MAX_OVERRIDES 
+ * overrides are set at once, the additional overrides are ignored. If more than MAX_PATTERNS
+ * pixels are set to a pattern, the additional pixels are solid. If Base has more than 
+ * N pixels only the first N are used.
+ */
+template<class Base, size_t N, size_t MAX_OVERRIDES = ((N < 8) ? N : 8), size_t MAX_PATTERNS = ((N < 4) ? N : 4), bool OUTPUT_CORRECTION = false>
+class StatusLedRK_Static : public Base {
+public:
+    /**
+     * @brief Construct the object. Parameters are passed to the Base constructor.
+     */
+    template<typename... Args>
+    StatusLedRK_Static(Args&&... args) : Base(std::forward<Args>(args)...) {
+        static_assert(N > 0 && N < StatusLedRK::HEAP_POS_NONE, "N must be between 1 and 65534");
+        static_assert(MAX_PATTERNS <= N, "MAX_PATTERNS cannot be larger than N");
+
+        if (this->numPixels > N) {
+            this->numPixels = N;
+        }
+        this->ownsStorage = false;
+        this->colors = staticColors;
+        this->styles = staticStyles;
+        this->blinkBits = staticBlinkBits;
+        this->overrideBits = staticOverrideBits;
+        this->dirty = staticDirty;
+        this->heapPos = staticHeapPos;
+        this->heap = staticHeap;
+        this->heapCapacity = N;
+        this->overrides = staticOverrides;
+        this->overridesCapacity = MAX_OVERRIDES;
+        this->patterns = staticPatterns;
+        this->patternsCapacity = MAX_PATTERNS;
+        if (OUTPUT_CORRECTION) {
+            this->outputTable = staticOutputTable;
+            this->pixelBrightness = staticPixelBrightness;
+        }
+        this->setOutputCache(staticOutputCache);
+    }
+
+    /**
+     * @brief Destructor. Stops the worker thread before the storage is destroyed.
+     */
+    virtual ~StatusLedRK_Static() {
+        this->stopSystemMirror();
+        this->stopThread();
+    }
+
+protected:
+    static const size_t NUM_WORDS = (N + 31) / 32; //!< Number of uint32_t words in a bit array of N pixels
+
+    uint8_t staticColors[N * 3]; //!< Storage for colors
+    uint8_t staticStyles[(N + 3) / 4]; //!< Storage for styles
+    uint32_t staticBlinkBits[NUM_WORDS]; //!< Storage for blinkBits
+    uint32_t staticOverrideBits[NUM_WORDS]; //!< Storage for overrideBits
+    uint32_t staticDirty[NUM_WORDS]; //!< Storage for dirty
+    uint16_t staticHeapPos[N]; //!< Storage for heapPos
+    StatusLedRK::Deadline staticHeap[N]; //!< Storage for heap
+    StatusLedRK::LedOverride staticOverrides[MAX_OVERRIDES == 0 ? 1 : MAX_OVERRIDES]; //!< Storage for overrides
+    StatusLedRK::PatternState staticPatterns[MAX_PATTERNS == 0 ? 1 : MAX_PATTERNS]; //!< Storage for patterns
+    uint8_t staticOutputTable[OUTPUT_CORRECTION ? (3 * 256) : 1]; //!< Storage for outputTable
+    uint8_t staticPixelBrightness[OUTPUT_CORRECTION ? N : 1]; //!< Storage for pixelBrightness
+    uint8_t staticOutputCache[Base::OUTPUT_CACHE_BYTES_PER_PIXEL ? (N * Base::OUTPUT_CACHE_BYTES_PER_PIXEL) : 1]; //!< Storage for the output cache of Base, if it has one
+};
+
+/**
+ * @brief Class for status LED connected to PWM pins
+ */
+class StatusLedRK_RGB : public StatusLedRK {
+public:
+    /**
+     * @brief Structure that defines the pins used for red, green, and blue of an RGB LED
+     */
+    typedef struct {
+        pin_t rPin; //!< Red pin
+        pin_t gPin; //!< Green pin
+        pin_t bPin; //!< Blue pin
+    } LedPins;
+
+
+    /**
+     * @brief Construct a new Status Led object
+     * 
+     * @param numPixels Number of entries in pinsArray
+     * @param pinsArray The pinsArray is typically a const global structure. This is not copied! 
+     * @param isCommonAnode true for common anode (common pin connected to VCC) or false for common cathode (common pin connected to GND)
+     */
+	StatusLedRK_RGB(size_t numPixels, const LedPins *pinsArray, bool isCommonAnode = true);
+
+    /**
+     * @brief Destructor
+     */
+	virtual ~StatusLedRK_RGB();
+
+    /**
+     * @brief Sets the pinMode of the LED pins. Called from setup().
+     */
+	virtual void setup2();
+
+    /**
+     * @brief Update one RGB LED to match the state in the StatusLedRK object
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param color RGB color to display
+     */
+	virtual void showPixel(uint16_t n, uint32_t color);
+
+    /**
+     * @brief Marks the output cache as invalid so the next show() writes every channel. Called from showAll().
+     */
+    virtual void invalidateCache() { cacheValid = false; };
+
+    /**
+     * @brief Marks the output cache as valid after all changed pixels were written
+     */
+    virtual void showComplete() { cacheValid = (outputCache != 0); };
+
+protected:
+    /**
+     * @brief Used internally to write one color channel if it changed
+     * 
+     * @param index Index into outputCache (pixel * 3 + channel)
+     * @param pin The GPIO for this channel
+     * @param value The PWM value, already inverted for common anode
+     * 
+     * 0 and 255 are written with digitalWrite() so fully off and fully on channels don't use PWM.
+     */
+    void writeChannel(size_t index, pin_t pin, uint8_t value);
+
+    /**
+     * @brief Used internally by StatusLedRK_Static to supply outputCache so it's not allocated in setup()
+     */
+    void setOutputCache(uint8_t *cache) { outputCache = cache; };
+
+    static const size_t OUTPUT_CACHE_BYTES_PER_PIXEL = 3; //!< Size of outputCache per pixel
+
+    const LedPins *pinsArray; //!< Definition of the GPIO used for the RGB LED PWM pins
+    bool isCommonAnode = true;  //!< true for common anode (common pin connected to VCC) or false for common cathode (common pin connected to GND)
+    uint8_t *outputCache = 0; //!< Last value written to each pin, 3 per pixel. Allocated during setup() unless supplied by StatusLedRK_Static.
+    bool cacheValid = false; //!< true if outputCache matches the hardware
+};
+
+/**
+ * @brief Class that displays one set of pixels on several other StatusLedRK objects
+ * 
+ * The composite object holds the pixel state and does the blinking, patterns, overrides, 
+ * brightness, and gamma. The outputs are only used to write to the hardware, so they don't
+ * allocate any pixel state, and their setup() and loop() must not be called. For example, 
+ * to mirror pixel 0 on an RGB LED and the first pixel of a NeoPixel strip:
+ * 
+ * ```
+ * StatusLedRK_RGB rgbOutput(1, ledPins);
+ * StatusLedRK_Neopixel stripOutput(&strip);
+ * StatusLedRK_Composite statusLed(1);
+ * 
+ * // In setup()
+ * statusLed.addOutput(&rgbOutput, 0, 1);
+ * statusLed.addOutput(&stripOutput, 0, 1);
+ * statusLed.setup();
+ * ```
+ * 
+ * Outputs that normally blink by themselves, like StatusLedRK_PCA9531, are blinked by the 
+ * composite object instead so all of the outputs stay in sync.
+ * 
+ * A logical pixel can also be a group of output pixels that always show the same thing, 
+ * such as a segment of a ring, using addOutputSegments(). The group has one color, style,
+ * and set of overrides, and it's only expanded to the output pixels when shown, so loop()
+ * does the same work for a group as for a single pixel. For example, a 24 pixel ring as 
+ * 4 segments of 6:
+ * 
+ * ```
+ * const StatusLedRK_Composite::Segment ringSegments[4] = { {0, 6}, {6, 6}, {12, 6}, {18, 6} };
+ * StatusLedRK_Composite statusLed(4);
+ * 
+ * // In setup()
+ * statusLed.addOutputSegments(&stripOutput, ringSegments, 4);
+ * statusLed.setup();
+ * 
+ * // Segment 2 blinks red
+ * statusLed.setColorStyle(2, StatusLedRK::COLOR_RED, StatusLedRK::STYLE_BLINK_FAST);
+ * ```
+ */
+class StatusLedRK_Composite : public StatusLedRK {
+public:
+    /**
+     * @brief Range of output pixels displayed by one logical pixel, see addOutputSegments()
+     */
+    typedef struct {
+        uint16_t first; //!< First output pixel
+        uint16_t count; //!< Number of output pixels
+    } Segment;
+
+    /**
+     * @brief Construct a new composite object
+     * 
+     * @param numPixels Number of logical pixels
+     */
+    StatusLedRK_Composite(size_t numPixels) : StatusLedRK(numPixels) {}
+
+    /**
+     * @brief Destructor. The outputs are not deleted.
+     */
+    virtual ~StatusLedRK_Composite() {
+        stopSystemMirror();
+        stopThread();
+    }
+
+    /**
+     * @brief Display a range of logical pixels on an output
+     * 
+     * @param output The StatusLedRK object to write to. This is not copied and must remain valid.
+     * @param firstPixel First logical pixel displayed on this output
+     * @param count Number of logical pixels displayed on this output
+     * @param outputFirst Pixel number on the output of firstPixel (default: 0)
+     * 
+     * @return true if added, false if there are already MAX_OUTPUTS outputs
+     * 
+     * Call before setup(). The same logical pixel can be displayed on more than one output.
+     */
+    bool addOutput(StatusLedRK *output, uint16_t firstPixel, uint16_t count, uint16_t outputFirst = 0);
+
+    /**
+     * @brief Display logical pixels on an output using a table of output pixel numbers
+     * 
+     * @param output The StatusLedRK object to write to. This is not copied and must remain valid.
+     * @param pixelMap Output pixel number for each logical pixel, starting with logical pixel 0,
+     * or NO_PIXEL if that logical pixel is not displayed on this output. This is not copied.
+     * @param count Number of entries in pixelMap
+     * 
+     * @return true if added, false if there are already MAX_OUTPUTS outputs
+     */
+    bool addOutputMap(StatusLedRK *output, const uint16_t *pixelMap, uint16_t count);
+
+    /**
+     * @brief Display each logical pixel on a range of output pixels
+     * 
+     * @param output The StatusLedRK object to write to. This is not copied and must remain valid.
+     * @param segments Output pixels for each logical pixel, starting with logical pixel 0. 
+     * A count of 0 means that logical pixel is not displayed on this output. This is not copied.
+     * @param count Number of entries in segments
+     * 
+     * @return true if added, false if there are already MAX_OUTPUTS outputs
+     */
+    bool addOutputSegments(StatusLedRK *output, const Segment *segments, uint16_t count);
+
+    /**
+     * @brief Calls setup2() of each output. Called from setup().
+     */
+    virtual void setup2();
+
+    /**
+     * @brief Write one pixel to every output that displays it
+     * 
+     * @param n Logical pixel number (0 is the first pixel)
+     * @param color RGB color to display
+     */
+    virtual void showPixel(uint16_t n, uint32_t color) { showPixels(&n, &color, 1); };
+
+    /**
+     * @brief Write changed pixels to every output that displays them, as one showPixels() call per output
+     * 
+     * @param pixels Logical pixel number of each color, in increasing order
+     * @param colorsArray RGB color to display for each pixel, already corrected for brightness and gamma
+     * @param count Number of entries in pixels and colorsArray
+     * 
+     * Each output gets its pixel numbers in logical pixel order, so they're only in increasing 
+     * order on the output if its mapping is. A pixel in a segment or mapped to more than one 
+     * output is written to each of them.
+     */
+    virtual void showPixels(const uint16_t *pixels, const uint32_t *colorsArray, size_t count);
+
+    /**
+     * @brief Calls showComplete() of the outputs that had pixels written since the last show()
+     */
+    virtual void showComplete();
+
+    /**
+     * @brief Calls invalidateCache() of each output. Called from showAll().
+     */
+    virtual void invalidateCache();
+
+    static const size_t MAX_OUTPUTS = 4; //!< Maximum number of outputs
+    static const uint16_t NO_PIXEL = 0xffff; //!< Value in a pixelMap for a logical pixel not on that output
+
+protected:
+    /**
+     * @brief Used internally to hold the pixel mapping of one output
+     */
+    typedef struct {
+        StatusLedRK *output; //!< Object to write to
+        const uint16_t *pixelMap; //!< Output pixel of each logical pixel from firstPixel, or NULL to use outputFirst
+        const Segment *segments; //!< Output pixels of each logical pixel from firstPixel, or NULL to use pixelMap or outputFirst
+        uint16_t firstPixel; //!< First logical pixel on this output
+        uint16_t count; //!< Number of logical pixels on this output
+        uint16_t outputFirst; //!< Output pixel of firstPixel, if pixelMap is NULL
+        bool written; //!< Pixels were written to this output since its last showComplete()
+    } Output;
+
+    /**
+     * @brief Used internally to add an output
+     */
+    bool addOutputMapping(StatusLedRK *output, const uint16_t *pixelMap, uint16_t firstPixel, uint16_t count, uint16_t outputFirst);
+
+    Output outputs[MAX_OUTPUTS]; //!< Outputs added with addOutput()
+    size_t outputCount = 0; //!< Number of entries in outputs
+};
+
+/**
+ * @brief Decoder for a compact binary protocol that sets pixels, read from a Stream such as Serial1
+ * 
+ * A frame starts with FRAME_START, followed by any number of commands, and ends with CMD_END. 
+ * Multi-byte values are little endian. Colors are 3 bytes, red, green, then blue. Pixels 
+ * past the end of the strip are ignored.
+ * 
+ * | Command | Parameters | Description |
+ * | :--- | :--- | :--- |
+ * | CMD_FILL | first (2), count (2), color (3), style (1) | Set a range of pixels to one color and style |
+ * | CMD_RUNS | first (2), style (1), numRuns (1), then numRuns of: length (1), color (3) | Set consecutive runs of pixels, starting at first |
+ * | CMD_STYLES | first (2), count (2), then (count + 3) / 4 bytes | Set the style of count pixels, 2 bits per pixel starting with the low bits, without changing the color |
+ * | CMD_OVERRIDE | pixel (2), color (3), style (1), howLong (4), priority (1), flags (1) | setOverrideStyle(). Bit 0 of flags is clearOnChange. |
+ * | CMD_END | | End of the frame |
+ * 
+ * Bytes are decoded as they arrive, so frames are not buffered and can be split across calls
+ * to process(). The changes are applied to the pixel state directly, and shown once per 
+ * frame (once for all of the frames read by the same call to process()). An unknown command
+ * or a style other than STYLE_ON, STYLE_BLINK_SLOW, or STYLE_BLINK_FAST (patterns can't be 
+ * sent) ends the frame, and bytes are ignored until the next FRAME_START. A FRAME_START in place
+ * of a command ends the frame and starts a new one.
+ */
+class StatusLedRK_StreamDecoder {
+public:
+    /**
+     * @brief Construct a decoder
+     * 
+     * @param led The object to set the pixels of. This is not copied and must remain valid.
+     */
+    StatusLedRK_StreamDecoder(StatusLedRK *led) : led(led) {}
+
+    /**
+     * @brief Decode all of the bytes available from a stream. Call from loop().
+     * 
+     * @param stream The stream to read, such as Serial1
+     * @return Number of frames completed
+     */
+    size_t process(Stream &stream);
+
+    /**
+     * @brief Decode one byte
+     * 
+     * @param b The byte
+     * @return true if this completed a frame (and it was shown)
+     */
+    bool processByte(uint8_t b);
+
+    /**
+     * @brief Discard a partially decoded frame and wait for FRAME_START
+     */
+    void reset() { state = STATE_IDLE; };
+
+    /**
+     * @brief Get the number of frames decoded
+     */
+    uint32_t getFrameCount() const { return frameCount; };
+
+    /**
+     * @brief Get the number of frames that ended with an unknown command, an invalid style, or FRAME_START
+     */
+    uint32_t getErrorCount() const { return errorCount; };
+
+    static const uint8_t FRAME_START = 0xa5; //!< Start of a frame
+    static const uint8_t CMD_END = 0x00; //!< End of a frame
+    static const uint8_t CMD_FILL = 0x01; //!< Set a range of pixels to one color and style
+    static const uint8_t CMD_RUNS = 0x02; //!< Set runs of pixels to colors
+    static const uint8_t CMD_STYLES = 0x03; //!< Set the style of a range of pixels
+    static const uint8_t CMD_OVERRIDE = 0x04; //!< Set an override layer on a pixel
+
+protected:
+    /**
+     * @brief Used internally to decode one byte with the object already locked
+     */
+    bool decodeByte(uint8_t b);
+
+    /**
+     * @brief Used internally to act on a command once its fixed-size parameters have been read
+     */
+    void executeCommand();
+
+    /**
+     * @brief Used internally to set the color and style of one pixel
+     */
+    void setPixel(uint16_t n, uint32_t color, uint8_t style);
+
+    /**
+     * @brief Used internally to check a style received in the stream
+     * 
+     * @return true if it's STYLE_ON, STYLE_BLINK_SLOW, or STYLE_BLINK_FAST. Otherwise the frame
+     * is ended as a protocol error and false is returned.
+     */
+    bool checkStyle(uint8_t style);
+
+    /**
+     * @brief Used internally to end the frame after a protocol error and wait for the next FRAME_START
+     */
+    void protocolError();
+
+    /**
+     * @brief Used internally to finish a frame and show it
+     */
+    void endFrame();
+
+    /**
+     * @brief Used internally to get a 16-bit little endian value from params
+     */
+    uint16_t getParam16(size_t offset) const { return (uint16_t)(params[offset] | (params[offset + 1] << 8)); };
+
+    /**
+     * @brief Used internally to get a 24-bit color from params
+     */
+    uint32_t getParamColor(size_t offset) const { return ((uint32_t)params[offset] << 16) | ((uint32_t)params[offset + 1] << 8) | (uint32_t)params[offset + 2]; };
+
+    static const uint8_t STATE_IDLE = 0; //!< Waiting for FRAME_START
+    static const uint8_t STATE_COMMAND = 1; //!< Waiting for a command
+    static const uint8_t STATE_PARAMS = 2; //!< Reading the fixed-size parameters of command
+    static const uint8_t STATE_RUN = 3; //!< Reading the runs of CMD_RUNS
+    static const uint8_t STATE_STYLES = 4; //!< Reading the style bytes of CMD_STYLES
+
+    StatusLedRK *led; //!< Object to set the pixels of
+    uint8_t state = STATE_IDLE; //!< Decoder state, one of the STATE_ constants
+    uint8_t command = 0; //!< Command being decoded
+    uint8_t params[12]; //!< Parameters of command
+    uint8_t paramsLen = 0; //!< Number of bytes in params
+    uint8_t paramsNeeded = 0; //!< Number of bytes of params for command, or per run in STATE_RUN
+    uint8_t style = 0; //!< Style for STATE_RUN
+    uint32_t pixel = 0; //!< Next pixel for STATE_RUN and STATE_STYLES. 32 bits so it can't wrap around to pixel 0.
+    uint16_t remaining = 0; //!< Runs or pixels left in STATE_RUN or STATE_STYLES
+    bool inFrame = false; //!< Changes were made that have not been shown yet
+    uint32_t frameCount = 0; //!< Number of frames decoded
+    uint32_t errorCount = 0; //!< Number of frames ended with an unknown command
+};
+
+#ifdef PARTICLE_NEOPIXEL_H
+// Library: neopixel
+// https://github.com/technobly/Particle-NeoPixel
+
+class StatusLedRK_Neopixel : public StatusLedRK {
+public:
+    /**
+     * @brief Construct a new StatusLedRK_StatusLedRK_NeopixelRGB object
+     * 
+     * @param strip 
+     */
+	StatusLedRK_Neopixel(Adafruit_NeoPixel *strip) : StatusLedRK(strip->numPixels()), strip(strip) {
+    }
+
+    /**
+     * @brief Destructor
+     */
+	virtual ~StatusLedRK_Neopixel() {
+        stopSystemMirror();
+        stopThread();
+    }
+
+    /**
+     * @brief Finds the byte order of the strip so show() can write into its pixel buffer. Called from setup().
+     * 
+     * The order is found by setting the first two pixels with setPixelColor() and looking at the
+     * buffer from getPixels(), so it works with any 3 or 4 byte per pixel strip type. If the
+     * order can't be determined, or the strip brightness was changed, pixels are written 
+     * using setPixelColor() instead.
+     */
+    virtual void setup2() {
+        uint8_t *buf = strip->getPixels();
+
+        bytesPerPixel = 0;
+        if (!buf || strip->getNumLeds() < 2 || strip->getBrightness() != 255) {
+            return;
+        }
+
+        strip->setPixelColor(0, 0x010203);
+        strip->setPixelColor(1, 0x040506);
+        for(uint8_t bpp = 3; bpp <= 4 && bytesPerPixel == 0; bpp++) {
+            int8_t offsets[3] = { -1, -1, -1 };
+            for(uint8_t ii = 0; ii < bpp; ii++) {
+                if (buf[ii] >= 1 && buf[ii] <= 3 && buf[bpp + ii] == buf[ii] + 3) {
+                    offsets[buf[ii] - 1] = ii;
+                }
+            }
+            if (offsets[0] >= 0 && offsets[1] >= 0 && offsets[2] >= 0) {
+                bytesPerPixel = bpp;
+                redOffset = offsets[0];
+                greenOffset = offsets[1];
+                blueOffset = offsets[2];
+            }
+        }
+        strip->setPixelColor(0, 0);
+        strip->setPixelColor(1, 0);
+    }
+
+    /**
+     * @brief Write changed pixels directly into the strip buffer in the strip's byte order
+     * 
+     * @param pixels Pixel number of each color, in any order
+     * @param colorsArray RGB color to display for each pixel
+     * @param count Number of entries in pixels and colorsArray
+     */
+    virtual void showPixels(const uint16_t *pixels, const uint32_t *colorsArray, size_t count) {
+        if (bytesPerPixel == 0) {
+            StatusLedRK::showPixels(pixels, colorsArray, count);
+            return;
+        }
+
+        uint8_t *buf = strip->getPixels();
+        uint16_t scale = (uint16_t)strip->getBrightness() + 1;
+
+        for(size_t ii = 0; ii < count; ii++) {
+            uint32_t color = colorsArray[ii];
+            uint8_t red = (uint8_t)(color >> 16);
+            uint8_t green = (uint8_t)(color >> 8);
+            uint8_t blue = (uint8_t)color;
+            if (scale != 256) {
+                // Same scaling setPixelColor() does after strip->setBrightness()
+                red = (uint8_t)((red * scale) >> 8);
+                green = (uint8_t)((green * scale) >> 8);
+                blue = (uint8_t)((blue * scale) >> 8);
+            }
+            uint8_t *p = &buf[pixels[ii] * bytesPerPixel];
+            p[redOffset] = red;
+            p[greenOffset] = green;
+            p[blueOffset] = blue;
         }
+    }
+
+    /**
+     * @brief Update one pixel in the Neopixel strip buffer
+     * 
+     * @param n Pixel number (0 is the first pixel)
+     * @param color RGB color to display
+     */
+	virtual void showPixel(uint16_t n, uint32_t color) {
+        strip->setPixelColor(n, color);
+    }
+
+    /**
+     * @brief Send the Neopixel strip buffer to the strip after the changed pixels were updated
+     */
+	virtual void showComplete() {
         strip->show();
     }
 
 
 protected:
 	Adafruit_NeoPixel *strip = nullptr;
+    uint8_t bytesPerPixel = 0; //!< Bytes per pixel in the strip buffer, or 0 to use setPixelColor()
+    uint8_t redOffset = 0; //!< Offset of red in each pixel of the strip buffer
+    uint8_t greenOffset = 0; //!< Offset of green in each pixel of the strip buffer
+    uint8_t blueOffset = 0; //!< Offset of blue in each pixel of the strip buffer
 };
 
 #endif // PARTICLE_NEOPIXEL_H
 
 #ifdef __PCA9531_RK
+/**
+ * @brief Used internally to check if the PCA9531 class has a public writeRegister(reg, value) method
+ * 
+ * Older versions of the PCA9531_RK library only have setLed() and updateLeds(), so 
+ * StatusLedRK_PCA9531 uses the registers directly only if writeRegister() exists.
+ */
+template<class T>
+class StatusLedRK_PCA9531_HasWriteRegister {
+    template<class U>
+    static auto check(U *chip) -> decltype(chip->writeRegister((uint8_t)0, (uint8_t)0), std::true_type());
+
+    template<class U>
+    static std::false_type check(...);
+
+public:
+    static const bool value = decltype(check<T>(nullptr))::value; //!< true if T::writeRegister() can be called
+};
+
+/**
+ * @brief Class for LEDs connected to a PCA9531 8-bit I2C LED dimmer
+ * 
+ * If the PCA9531_RK library has a public writeRegister() method, the blink channels and LED 
+ * selectors are set by register, so blinking LEDs are blinked by the chip itself and do not 
+ * require any I2C traffic from loop(). Otherwise only PCA9531::MAX_LED, setLed() and updateLeds()
+ * are used and blinking is done in software, as it is with useRegisters set to false.
+ * 
+ * The LEDs are only on or off, as with PCA9531::setLed(). Any color other than black is fully on,
+ * including a color dimmed by setBrightness(), and a blinking LED blinks between fully on and off.
+ */
 class StatusLedRK_PCA9531 : public StatusLedRK {
 public:
     /**
-     * @brief Construct a new StatusLedRK_StatusLedRK_NeopixelRGB object
+     * @brief Construct a new StatusLedRK_PCA9531 object
      * 
-     * @param strip 
+     * @param strip The PCA9531 object for the chip. It must remain valid.
+     * 
+     * @param useRegisters true (the default) to write the chip registers and let the chip blink the LEDs,
+     * false to only use setLed() and updateLeds() and blink in software. Ignored (always false) if the 
+     * PCA9531_RK library does not have a public writeRegister() method.
+     */
+	StatusLedRK_PCA9531(PCA9531 *strip, bool useRegisters = true) : StatusLedRK(PCA9531::MAX_LED), strip(strip),
+        useRegisters(useRegisters && StatusLedRK_PCA9531_HasWriteRegister<PCA9531>::value) {
+        hardwareBlink = this->useRegisters;
+    }
+
+    /**
+     * @brief Sets up the two blink channels of the chip. Called from setup().
+     * 
+     * STYLE_BLINK_SLOW uses PSC0/PWM0 and STYLE_BLINK_FAST uses PSC1/PWM1, both at 50% duty cycle,
+     * so blinking LEDs do not require any I2C traffic from loop(). The prescaler period is 
+     * (PSC + 1) / 152 seconds, so the slow blink period is limited to 1.68 seconds instead of 2.
      */
-	StatusLedRK_PCA9531(PCA9531 *strip) : StatusLedRK(PCA9531::MAX_LED), strip(strip) {
+    virtual void setup2() {
+        if (useRegisters) {
+            writeRegister(REG_PSC0, blinkPrescaler(SLOW_BLINK_MS));
+            writeRegister(REG_PWM0, 128);
+            writeRegister(REG_PSC1, blinkPrescaler(FAST_BLINK_MS));
+            writeRegister(REG_PWM1, 128);
+        }
+        cacheValid = false;
     }
 
     /**
      * @brief Destructor
      */
-	virtual ~StatusLedRK_PCA9531() {        
+	virtual ~StatusLedRK_PCA9531() {
+        stopSystemMirror();
+        stopThread();
+    }
+
+    /**
+     * @brief Update the selector of one LED without sending it to the chip yet
+     * 
+     * @param n LED number (0 is the first LED)
+     * @param color RGB color to display
+     */
+	virtual void showPixel(uint16_t n, uint32_t color) {
+        if (!useRegisters) {
+            strip->setLed(n, color, false);
+            return;
+        }
+
+        uint8_t select = LED_OFF;
+        if (color != 0) {
+            // Without hardwareBlink (as the output of a StatusLedRK_Composite) blinking is done in software
+            switch(hardwareBlink ? resolveStyle(n) : STYLE_ON) {
+                case STYLE_BLINK_SLOW:
+                    select = LED_PWM0;
+                    break;
+
+                case STYLE_BLINK_FAST:
+                    select = LED_PWM1;
+                    break;
+
+                default:
+                    select = LED_ON;
+                    break;
+            }
+        }
+        uint8_t shift = (n % 4) * 2;
+        ledSelect[n / 4] = (uint8_t)((ledSelect[n / 4] & ~(0x3 << shift)) | (select << shift));
     }
 
     /**
-     * @brief Update the strip to match the state in the StatusLedRK object
+     * @brief Send the LED selector registers that changed to the chip
      */
-	virtual void show() {
-        for(uint16_t ii = 0; ii < getNumPixels(); ii++) {
-            strip->setLed(ii, getColorWithOverride(ii), false);
+	virtual void showComplete() {
+        if (!useRegisters) {
+            strip->updateLeds();
+            return;
+        }
+
+        for(size_t ii = 0; ii < 2; ii++) {
+            if (!cacheValid || ledSelect[ii] != ledSelectWritten[ii]) {
+                writeRegister((uint8_t)(REG_LS0 + ii), ledSelect[ii]);
+                ledSelectWritten[ii] = ledSelect[ii];
+            }
         }
-        strip->updateLeds();
+        cacheValid = true;
+    }
+
+    /**
+     * @brief Write both LED selector registers on the next show, used by showAll()
+     */
+    virtual void invalidateCache() { cacheValid = false; };
+
+    /**
+     * @brief Returns true if the chip registers are written directly and the chip blinks the LEDs
+     */
+    bool getUseRegisters() const { return useRegisters; };
+
+    /**
+     * @brief Get the PSC register value for a blink style
+     * 
+     * @param blinkMs Milliseconds per on or off state, such as SLOW_BLINK_MS
+     */
+    static uint8_t blinkPrescaler(unsigned long blinkMs) {
+        unsigned long psc = (blinkMs * 2 * 152) / 1000;
+        return (uint8_t)((psc > 256) ? 255 : (psc - 1));
     }
 
+    static const uint8_t REG_PSC0 = 1; //!< Frequency prescaler 0 register
+    static const uint8_t REG_PWM0 = 2; //!< PWM 0 register
+    static const uint8_t REG_PSC1 = 3; //!< Frequency prescaler 1 register
+    static const uint8_t REG_PWM1 = 4; //!< PWM 1 register
+    static const uint8_t REG_LS0 = 5; //!< LED 0-3 selector register
+    static const uint8_t REG_LS1 = 6; //!< LED 4-7 selector register
+
+    static const uint8_t LED_OFF = 0; //!< LED selector value: off
+    static const uint8_t LED_ON = 1; //!< LED selector value: on
+    static const uint8_t LED_PWM0 = 2; //!< LED selector value: blinks at the PSC0/PWM0 rate
+    static const uint8_t LED_PWM1 = 3; //!< LED selector value: blinks at the PSC1/PWM1 rate
 
 protected:
+    /**
+     * @brief Used internally to write one chip register. Only called when useRegisters is true.
+     */
+    void writeRegister(uint8_t reg, uint8_t value) {
+        writeRegister(strip, reg, value, std::integral_constant<bool, StatusLedRK_PCA9531_HasWriteRegister<PCA9531>::value>());
+    }
+
+    /**
+     * @brief Used internally to call PCA9531::writeRegister(), only compiled if it exists
+     */
+    template<class T>
+    static void writeRegister(T *chip, uint8_t reg, uint8_t value, std::true_type) {
+        chip->writeRegister(reg, value);
+    }
+
+    /**
+     * @brief Used internally when PCA9531::writeRegister() does not exist, never called
+     */
+    template<class T>
+    static void writeRegister(T *, uint8_t, uint8_t, std::false_type) {
+    }
+
 	PCA9531 *strip = nullptr;
+    bool useRegisters = true; //!< true to write the chip registers directly, false to use setLed() and updateLeds()
+    uint8_t ledSelect[2] = { 0, 0 }; //!< LS0 and LS1 register values, 2 bits per LED
+    uint8_t ledSelectWritten[2] = { 0, 0 }; //!< LS0 and LS1 as last written to the chip
+    bool cacheValid = false; //!< true if ledSelectWritten matches the chip
 };
 #endif // __PCA9531_RK
 
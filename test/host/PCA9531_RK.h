@@ -0,0 +1,96 @@
+#ifndef __PCA9531_RK
+#define __PCA9531_RK
+
+// Host stand-in for the PCA9531 8-bit I2C LED dimmer library. It only has the public API
+// of the PCA9531_RK library that StatusLedRK uses, plus members marked mock only. It models
+// the chip's registers and counts the I2C transactions that would be issued.
+
+#include "Particle.h"
+
+class PCA9531 {
+public:
+    static const uint16_t MAX_LED = 8;
+
+    PCA9531() {}
+
+    void begin() {}
+
+    /**
+     * @brief Set an LED on (any non-zero color) or off (0). If update is true, the chip is updated now.
+     */
+    void setLed(uint16_t ledNum, uint32_t color, bool update = true) {
+        setLedCount++;
+        if (ledNum < MAX_LED) {
+            ledOn[ledNum] = (color != 0);
+        }
+        if (update) {
+            updateLeds();
+        }
+    }
+
+    /**
+     * @brief Write the on/off state from setLed() to the LED selector registers over I2C
+     */
+    void updateLeds() {
+        updateLedsCount++;
+
+        uint8_t ls[2] = { 0, 0 };
+        for(uint16_t ii = 0; ii < MAX_LED; ii++) {
+            ls[ii / 4] |= (ledOn[ii] ? 1 : 0) << ((ii % 4) * 2);
+        }
+        writeRegister(REG_LS0, ls[0]);
+        writeRegister(REG_LS1, ls[1]);
+    }
+
+    /**
+     * @brief Write one chip register (one I2C transaction)
+     */
+    void writeRegister(uint8_t reg, uint8_t value) {
+        i2cTransactionCount++;
+        if (reg < NUM_REGISTERS) {
+            registers[reg] = value;
+        }
+    }
+
+    /**
+     * @brief Whether an LED is lit at a point in time, computed from the registers only (mock only)
+     *
+     * @param ledNum LED number 0 - 7
+     * @param ms Time in milliseconds since the blink channels were started
+     */
+    bool isLit(uint16_t ledNum, uint32_t ms) const {
+        uint8_t select = (registers[REG_LS0 + ledNum / 4] >> ((ledNum % 4) * 2)) & 0x3;
+        if (select < 2) {
+            // LED off (0) or on (1)
+            return select == 1;
+        }
+        // Blinking at PSC0/PWM0 (2) or PSC1/PWM1 (3)
+        uint8_t psc = registers[(select == 2) ? REG_PSC0 : REG_PSC1];
+        uint8_t pwm = registers[(select == 2) ? REG_PWM0 : REG_PWM1];
+        uint32_t periodMs = ((uint32_t)psc + 1) * 1000 / 152;
+        return ((ms % periodMs) * 256) < ((uint32_t)pwm * periodMs);
+    }
+
+    static const uint8_t REG_PSC0 = 1; //!< Frequency prescaler 0 (mock only)
+    static const uint8_t REG_PWM0 = 2; //!< PWM register 0 (mock only)
+    static const uint8_t REG_PSC1 = 3; //!< Frequency prescaler 1 (mock only)
+    static const uint8_t REG_PWM1 = 4; //!< PWM register 1 (mock only)
+    static const uint8_t REG_LS0 = 5; //!< LED 0-3 selector (mock only)
+    static const uint8_t REG_LS1 = 6; //!< LED 4-7 selector (mock only)
+    static const uint8_t NUM_REGISTERS = 7; //!< Number of registers, including the input register 0 (mock only)
+
+    uint8_t registers[NUM_REGISTERS] = {0}; //!< Chip registers as last written over I2C (mock only)
+    bool ledOn[MAX_LED] = {0}; //!< On/off state of each LED set by setLed() (mock only)
+
+    uint32_t setLedCount = 0; //!< Number of calls to setLed() (mock only)
+    uint32_t updateLedsCount = 0; //!< Number of calls to updateLeds() (mock only)
+    uint32_t i2cTransactionCount = 0; //!< Number of I2C register writes (mock only)
+
+    void resetCounters() {
+        setLedCount = 0;
+        updateLedsCount = 0;
+        i2cTransactionCount = 0;
+    }
+};
+
+#endif // __PCA9531_RK
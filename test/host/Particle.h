@@ -0,0 +1,347 @@
+#ifndef __PARTICLE_H_HOST_MOCK
+#define __PARTICLE_H_HOST_MOCK
+
+// Minimal stand-in for the Device OS Particle.h so StatusLedRK can be built and
+// benchmarked on a Linux host. Only the APIs used by the library and the host
+// benchmark are provided. Hardware calls are counted instead of performed.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef uint16_t pin_t;
+typedef uint32_t system_tick_t;
+
+typedef enum {
+    INPUT,
+    OUTPUT,
+    INPUT_PULLUP,
+    INPUT_PULLDOWN
+} PinMode;
+
+#define HIGH 1
+#define LOW 0
+
+/**
+ * @brief Simulated hardware state shared by the mocks
+ */
+namespace HostMock {
+    inline std::atomic<system_tick_t> millisValue(0); //!< Value returned by millis(). Advance it to simulate time passing.
+
+    inline uint32_t pinModeCount = 0; //!< Number of calls to pinMode()
+    inline uint32_t analogWriteCount = 0; //!< Number of calls to analogWrite()
+    inline uint32_t digitalWriteCount = 0; //!< Number of calls to digitalWrite()
+    inline std::atomic<uint32_t> mutexUnlockErrors(0); //!< Number of os_mutex_recursive_unlock() calls by a thread that did not hold the lock
+
+    static const size_t MAX_PINS = 16384; //!< Pins above this value are counted but their value is not kept
+    inline uint8_t pinValue[MAX_PINS]; //!< Last value written to each pin
+
+    /**
+     * @brief Set the simulated millis() value
+     */
+    inline void setMillis(system_tick_t value) { millisValue = value; }
+
+    /**
+     * @brief Advance the simulated millis() value
+     */
+    inline void advanceMillis(system_tick_t ms) { millisValue += ms; }
+
+    /**
+     * @brief Clear the hardware write counters
+     */
+    inline void resetCounters() {
+        pinModeCount = 0;
+        analogWriteCount = 0;
+        digitalWriteCount = 0;
+    }
+};
+
+inline system_tick_t millis() {
+    return HostMock::millisValue;
+}
+
+inline uint32_t micros() {
+    // Real elapsed time, used for timing rather than scheduling
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void pinMode(pin_t pin, PinMode mode) {
+    (void) pin;
+    (void) mode;
+    HostMock::pinModeCount++;
+}
+
+inline void analogWrite(pin_t pin, uint32_t value) {
+    HostMock::analogWriteCount++;
+    if (pin < HostMock::MAX_PINS) {
+        HostMock::pinValue[pin] = (uint8_t) value;
+    }
+}
+
+inline void digitalWrite(pin_t pin, uint8_t value) {
+    HostMock::digitalWriteCount++;
+    if (pin < HostMock::MAX_PINS) {
+        HostMock::pinValue[pin] = value ? 255 : 0;
+    }
+}
+
+inline void delay(system_tick_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// Device OS concurrency HAL, implemented with the C++ standard library. Timeouts are
+// in real milliseconds, not the simulated millis() value.
+
+#define CONCURRENT_WAIT_FOREVER ((system_tick_t)-1)
+
+/**
+ * @brief Recursive mutex that knows which thread holds it, like os_mutex_recursive_t in Device OS
+ */
+struct HostRecursiveMutex {
+    std::recursive_mutex mutex;
+    std::atomic<std::thread::id> owner;
+    int lockCount = 0;
+};
+typedef HostRecursiveMutex *os_mutex_recursive_t;
+
+inline int os_mutex_recursive_create(os_mutex_recursive_t *mutex) { *mutex = new HostRecursiveMutex(); return 0; }
+inline int os_mutex_recursive_destroy(os_mutex_recursive_t mutex) { delete mutex; return 0; }
+
+inline int os_mutex_recursive_lock(os_mutex_recursive_t mutex) {
+    mutex->mutex.lock();
+    mutex->owner = std::this_thread::get_id();
+    mutex->lockCount++;
+    return 0;
+}
+
+inline int os_mutex_recursive_unlock(os_mutex_recursive_t mutex) {
+    if (mutex->owner != std::this_thread::get_id()) {
+        // An error on Device OS, and undefined behavior for std::recursive_mutex
+        HostMock::mutexUnlockErrors++;
+        return 1;
+    }
+    if (--mutex->lockCount == 0) {
+        mutex->owner = std::thread::id();
+    }
+    mutex->mutex.unlock();
+    return 0;
+}
+
+/**
+ * @brief Fixed-size queue of fixed-size items, like os_queue_t in Device OS
+ */
+struct HostQueue {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::vector<uint8_t>> items;
+    size_t itemSize;
+    size_t length;
+};
+typedef HostQueue *os_queue_t;
+
+inline int os_queue_create(os_queue_t *queue, size_t item_size, size_t item_count, void * /*reserved*/) {
+    *queue = new HostQueue();
+    (*queue)->itemSize = item_size;
+    (*queue)->length = item_count;
+    return 0;
+}
+inline int os_queue_destroy(os_queue_t queue, void * /*reserved*/) { delete queue; return 0; }
+
+inline int os_queue_put(os_queue_t queue, const void *item, system_tick_t /*delay*/, void * /*reserved*/) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (queue->items.size() >= queue->length) {
+        return 1;
+    }
+    const uint8_t *p = (const uint8_t *) item;
+    queue->items.emplace_back(p, p + queue->itemSize);
+    queue->cond.notify_one();
+    return 0;
+}
+
+inline int os_queue_take(os_queue_t queue, void *item, system_tick_t delay, void * /*reserved*/) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (delay == CONCURRENT_WAIT_FOREVER) {
+        queue->cond.wait(lock, [queue]() { return !queue->items.empty(); });
+    }
+    else
+    if (!queue->cond.wait_for(lock, std::chrono::milliseconds(delay), [queue]() { return !queue->items.empty(); })) {
+        return 1;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    return 0;
+}
+
+typedef void os_thread_return_t;
+typedef uint8_t os_thread_prio_t;
+
+#define OS_THREAD_PRIORITY_DEFAULT 2
+#define OS_THREAD_STACK_SIZE_DEFAULT 3072
+
+/**
+ * @brief Stand-in for the Device OS Thread class
+ */
+class Thread {
+public:
+    Thread(const char * /*name*/, std::function<os_thread_return_t(void)> function, os_thread_prio_t /*priority*/ = OS_THREAD_PRIORITY_DEFAULT, size_t /*stack_size*/ = OS_THREAD_STACK_SIZE_DEFAULT) : thread(function) {
+    }
+    ~Thread() {
+        if (thread.joinable()) {
+            thread.detach();
+        }
+    }
+    bool join() {
+        if (thread.joinable()) {
+            thread.join();
+        }
+        return true;
+    }
+
+protected:
+    std::thread thread;
+};
+
+/**
+ * @brief Lock an object with lock() and unlock() methods for the duration of the following block
+ */
+template<typename T>
+class HostLockGuard {
+public:
+    HostLockGuard(T &obj) : obj(obj), done(false) { obj.lock(); }
+    ~HostLockGuard() { obj.unlock(); }
+    T &obj;
+    bool done;
+};
+#define WITH_LOCK(lock) for (HostLockGuard<decltype(lock)> __guard(lock); !__guard.done; __guard.done = true)
+
+/**
+ * @brief Stand-in for the Device OS Logger. Messages go to stdout.
+ */
+class HostLogger {
+public:
+    void trace(const char *fmt, ...) const __attribute__((format(printf, 2, 3))) { va_list ap; va_start(ap, fmt); vlog("TRACE", fmt, ap); va_end(ap); }
+    void info(const char *fmt, ...) const __attribute__((format(printf, 2, 3))) { va_list ap; va_start(ap, fmt); vlog("INFO", fmt, ap); va_end(ap); }
+    void warn(const char *fmt, ...) const __attribute__((format(printf, 2, 3))) { va_list ap; va_start(ap, fmt); vlog("WARN", fmt, ap); va_end(ap); }
+    void error(const char *fmt, ...) const __attribute__((format(printf, 2, 3))) { va_list ap; va_start(ap, fmt); vlog("ERROR", fmt, ap); va_end(ap); }
+
+protected:
+    void vlog(const char *level, const char *fmt, va_list ap) const {
+        printf("%s: ", level);
+        vprintf(fmt, ap);
+        printf("\n");
+    }
+};
+
+inline HostLogger Log;
+
+/**
+ * @brief Stand-in for the Device OS Stream class. Only reading is provided.
+ */
+class Stream {
+public:
+    virtual ~Stream() {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+/**
+ * @brief Stream that reads bytes written to it from memory, like a serial port with a large buffer (mock only)
+ */
+class HostMemoryStream : public Stream {
+public:
+    virtual int available() { return (int)(data.size() - readPos); }
+    virtual int read() { return (readPos < data.size()) ? data[readPos++] : -1; }
+    virtual int peek() { return (readPos < data.size()) ? data[readPos] : -1; }
+
+    /**
+     * @brief Add bytes to be read
+     */
+    void write(const uint8_t *buf, size_t len) {
+        if (readPos == data.size()) {
+            // Everything was read, so start over instead of growing
+            data.clear();
+            readPos = 0;
+        }
+        data.insert(data.end(), buf, buf + len);
+    }
+
+protected:
+    std::vector<uint8_t> data;
+    size_t readPos = 0;
+};
+
+typedef void (raw_rgb_change_handler_t)(uint8_t, uint8_t, uint8_t);
+typedef std::function<raw_rgb_change_handler_t> wiring_rgb_change_handler_t;
+
+/**
+ * @brief Stand-in for the Device OS RGB class. Only the change handler is provided.
+ */
+class RGBClass {
+public:
+    void onChange(wiring_rgb_change_handler_t handler) {
+        std::lock_guard<std::mutex> lock(mutex);
+        changeHandler = handler;
+    }
+    void onChange(raw_rgb_change_handler_t *handler) {
+        onChange(handler ? wiring_rgb_change_handler_t(handler) : wiring_rgb_change_handler_t());
+    }
+    template<typename T>
+    void onChange(void (T::*handler)(uint8_t, uint8_t, uint8_t), T *instance) {
+        using namespace std::placeholders;
+        onChange(std::bind(handler, instance, _1, _2, _3));
+    }
+
+    /**
+     * @brief Call the change handler as the system does when the status LED changes (mock only)
+     * 
+     * This can be called from any thread, like the system LED update.
+     */
+    void mockChange(uint8_t r, uint8_t g, uint8_t b) {
+        std::lock_guard<std::mutex> lock(mutex);
+        changeCount++;
+        color[0] = r;
+        color[1] = g;
+        color[2] = b;
+        if (changeHandler) {
+            changeHandler(r, g, b);
+        }
+    }
+
+    /**
+     * @brief Get the last color passed to mockChange(), used by LED_RGB_Get() (mock only)
+     */
+    void mockGetColor(uint8_t *rgb) {
+        std::lock_guard<std::mutex> lock(mutex);
+        memcpy(rgb, color, sizeof(color));
+    }
+
+    uint32_t changeCount = 0; //!< Number of calls to mockChange() (mock only)
+
+protected:
+    std::mutex mutex;
+    wiring_rgb_change_handler_t changeHandler;
+    uint8_t color[3] = { 0, 0, 0 };
+};
+
+inline RGBClass RGB;
+
+/**
+ * @brief Stand-in for the Device OS rgbled HAL function that gets the current system LED color
+ */
+inline void LED_RGB_Get(uint8_t *rgb) {
+    RGB.mockGetColor(rgb);
+}
+
+#endif // __PARTICLE_H_HOST_MOCK
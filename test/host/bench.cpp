@@ -0,0 +1,614 @@
+// Host benchmark for StatusLedRK
+//
+// Builds the library against the stand-in Particle.h in this directory and times
+// loop(), show() and setColorStyle() for each backend as the number of pixels grows.
+// Hardware writes (analogWrite, setPixelColor, strip show, PCA9531 I2C) are counted
+// by the mocks and reported per operation alongside CPU time.
+//
+// Usage: ./bench [maxPixels]
+
+#include "Particle.h"
+
+#include "neopixel.h" // Must be before StatusLedRK.h
+#include "PCA9531_RK.h" // Must be before StatusLedRK.h
+
+#include "StatusLedRK.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+static const size_t pixelCounts[] = { 1, 8, 64, 256, 1024, 4096 };
+
+static const uint32_t colors[] = {
+    StatusLedRK::COLOR_RED, StatusLedRK::COLOR_GREEN, StatusLedRK::COLOR_BLUE, StatusLedRK::COLOR_YELLOW,
+    StatusLedRK::COLOR_CYAN, StatusLedRK::COLOR_MAGENTA, StatusLedRK::COLOR_NAVY, StatusLedRK::COLOR_WHITE,
+};
+static const size_t colorsCount = sizeof(colors) / sizeof(colors[0]);
+
+static constexpr StatusLedRK::StatusDefinition benchStatuses[] = {
+    { "red", StatusLedRK::COLOR_RED, StatusLedRK::STYLE_ON, nullptr, 0, 0, false },
+    { "green", StatusLedRK::COLOR_GREEN, StatusLedRK::STYLE_ON, nullptr, 0, 0, false },
+    { "blue", StatusLedRK::COLOR_BLUE, StatusLedRK::STYLE_ON, nullptr, 0, 0, false },
+    { "yellow", StatusLedRK::COLOR_YELLOW, StatusLedRK::STYLE_ON, nullptr, 0, 0, false },
+    { "cyan", StatusLedRK::COLOR_CYAN, StatusLedRK::STYLE_ON, nullptr, 0, 0, false },
+    { "magenta", StatusLedRK::COLOR_MAGENTA, StatusLedRK::STYLE_ON, nullptr, 0, 0, false },
+    { "navy", StatusLedRK::COLOR_NAVY, StatusLedRK::STYLE_ON, nullptr, 0, 0, false },
+    { "white", StatusLedRK::COLOR_WHITE, StatusLedRK::STYLE_ON, nullptr, 0, 0, false },
+};
+
+/**
+ * @brief Hardware write counts for one backend
+ */
+struct HwCounts {
+    uint64_t writes = 0; //!< Per-pixel (or per-channel) hardware writes
+    uint64_t refreshes = 0; //!< Whole-device refreshes (strip show, I2C register writes)
+};
+
+/**
+ * @brief One backend under test. Owns the StatusLedRK object and whatever it drives.
+ */
+class Backend {
+public:
+    virtual ~Backend() {}
+    virtual StatusLedRK *led() = 0;
+    virtual HwCounts counts() = 0;
+    virtual void resetCounts() = 0;
+};
+
+class BackendRGB : public Backend {
+public:
+    BackendRGB(size_t numPixels) : pins(numPixels) {
+        for(size_t ii = 0; ii < numPixels; ii++) {
+            pins[ii] = { (pin_t)(ii * 3), (pin_t)(ii * 3 + 1), (pin_t)(ii * 3 + 2) };
+        }
+        statusLed.reset(new StatusLedRK_RGB(numPixels, pins.data(), true));
+    }
+    virtual StatusLedRK *led() { return statusLed.get(); }
+    virtual HwCounts counts() {
+        HwCounts result;
+        result.writes = HostMock::analogWriteCount + HostMock::digitalWriteCount;
+        return result;
+    }
+    virtual void resetCounts() { HostMock::resetCounters(); }
+
+    std::vector<StatusLedRK_RGB::LedPins> pins;
+    std::unique_ptr<StatusLedRK_RGB> statusLed;
+};
+
+class BackendNeopixel : public Backend {
+public:
+    BackendNeopixel(size_t numPixels) : strip((uint16_t)numPixels, 2, WS2812B), statusLed(&strip) {
+        strip.begin();
+    }
+    virtual StatusLedRK *led() { return &statusLed; }
+    virtual HwCounts counts() {
+        HwCounts result;
+        result.writes = strip.setPixelColorCount;
+        result.refreshes = strip.showCount;
+        return result;
+    }
+    virtual void resetCounts() { strip.resetCounters(); }
+
+    Adafruit_NeoPixel strip;
+    StatusLedRK_Neopixel statusLed;
+};
+
+class BackendNeopixelStatic : public Backend {
+public:
+    BackendNeopixelStatic(size_t numPixels) : strip((uint16_t)numPixels, 2, WS2812B), statusLed(&strip) {
+        strip.begin();
+    }
+    virtual StatusLedRK *led() { return &statusLed; }
+    virtual HwCounts counts() {
+        HwCounts result;
+        result.writes = strip.setPixelColorCount;
+        result.refreshes = strip.showCount;
+        return result;
+    }
+    virtual void resetCounts() { strip.resetCounters(); }
+
+    Adafruit_NeoPixel strip;
+    StatusLedRK_Static<StatusLedRK_Neopixel, 4096, 4096, 4096, true> statusLed;
+};
+
+class BackendPCA9531 : public Backend {
+public:
+    BackendPCA9531() : statusLed(&chip) {
+        chip.begin();
+    }
+    virtual StatusLedRK *led() { return &statusLed; }
+    virtual HwCounts counts() {
+        HwCounts result;
+        // The LEDs are set by register, so every write is an I2C transaction
+        result.refreshes = chip.i2cTransactionCount;
+        return result;
+    }
+    virtual void resetCounts() { chip.resetCounters(); }
+
+    PCA9531 chip;
+    StatusLedRK_PCA9531 statusLed;
+};
+
+class BackendComposite : public Backend {
+public:
+    BackendComposite(size_t numPixels) : strip((uint16_t)numPixels, 2, WS2812B), stripOutput(&strip), chipOutput(&chip), statusLed(numPixels) {
+        strip.begin();
+        chip.begin();
+        // The whole strip, with the first 8 pixels mirrored on the PCA9531
+        statusLed.addOutput(&stripOutput, 0, (uint16_t)numPixels);
+        statusLed.addOutput(&chipOutput, 0, PCA9531::MAX_LED);
+    }
+    virtual StatusLedRK *led() { return &statusLed; }
+    virtual HwCounts counts() {
+        HwCounts result;
+        result.writes = strip.setPixelColorCount;
+        result.refreshes = strip.showCount + chip.i2cTransactionCount;
+        return result;
+    }
+    virtual void resetCounts() { strip.resetCounters(); chip.resetCounters(); }
+
+    Adafruit_NeoPixel strip;
+    PCA9531 chip;
+    StatusLedRK_Neopixel stripOutput;
+    StatusLedRK_PCA9531 chipOutput;
+    StatusLedRK_Composite statusLed;
+};
+
+class BackendGroups : public Backend {
+public:
+    BackendGroups(size_t numPixels) : strip((uint16_t)numPixels, 2, WS2812B), stripOutput(&strip), segments((numPixels + 7) / 8), statusLed(segments.size()) {
+        strip.begin();
+        // Every 8 pixels of the strip is one logical pixel
+        for(size_t ii = 0; ii < segments.size(); ii++) {
+            segments[ii].first = (uint16_t)(ii * 8);
+            segments[ii].count = (uint16_t)((numPixels - ii * 8 < 8) ? (numPixels - ii * 8) : 8);
+        }
+        statusLed.addOutputSegments(&stripOutput, segments.data(), (uint16_t)segments.size());
+    }
+    virtual StatusLedRK *led() { return &statusLed; }
+    virtual HwCounts counts() {
+        HwCounts result;
+        result.writes = strip.setPixelColorCount;
+        result.refreshes = strip.showCount;
+        return result;
+    }
+    virtual void resetCounts() { strip.resetCounters(); }
+
+    Adafruit_NeoPixel strip;
+    StatusLedRK_Neopixel stripOutput;
+    std::vector<StatusLedRK_Composite::Segment> segments;
+    StatusLedRK_Composite statusLed;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedNs(Clock::time_point start) {
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+static void printHeader() {
+    printf("%-8s %6s %-22s %10s %12s %12s %12s\n", "backend", "pixels", "operation", "ops", "ns/op", "writes/op", "refresh/op");
+}
+
+static void printResult(const char *backendName, size_t numPixels, const char *opName, uint64_t ops, double ns, const HwCounts &counts) {
+    printf("%-8s %6u %-22s %10lu %12.1f %12.2f %12.3f\n", backendName, (unsigned) numPixels, opName, (unsigned long) ops,
+        ns / (double) ops, (double) counts.writes / (double) ops, (double) counts.refreshes / (double) ops);
+}
+
+/**
+ * @brief Set up a mix of solid, blinking and overridden pixels
+ *
+ * Pixel n % 4 == 0 is solid, 1 is slow blink, 2 is fast blink, 3 is solid with a
+ * fast blinking override. Only the last pixel's style change triggers a show().
+ */
+static void setMixed(StatusLedRK *led) {
+    size_t numPixels = led->getNumPixels();
+
+    for(size_t ii = 0; ii < numPixels; ii++) {
+        uint32_t color = colors[ii % colorsCount];
+        switch(ii % 4) {
+            case 1:
+                led->setColorStyle((uint16_t)ii, color, StatusLedRK::STYLE_BLINK_SLOW, false);
+                break;
+            case 2:
+                led->setColorStyle((uint16_t)ii, color, StatusLedRK::STYLE_BLINK_FAST, false);
+                break;
+            default:
+                led->setColorStyle((uint16_t)ii, color, StatusLedRK::STYLE_ON, false);
+                break;
+        }
+    }
+    for(size_t ii = 3; ii < numPixels; ii += 4) {
+        led->setOverrideStyle((uint16_t)ii, StatusLedRK::COLOR_WHITE, StatusLedRK::STYLE_BLINK_FAST, 5000);
+    }
+    led->show();
+}
+
+/**
+ * @brief Run all operations against one backend instance
+ */
+static void runBackend(const char *backendName, Backend &backend, uint64_t opScale) {
+    StatusLedRK *led = backend.led();
+    size_t numPixels = led->getNumPixels();
+
+    HostMock::setMillis(1000);
+    led->setup();
+    led->resetStats();
+
+    // Bulk repaint without showing each pixel
+    {
+        uint64_t ops = numPixels * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->setColorStyle((uint16_t)(ii % numPixels), colors[ii % colorsCount], StatusLedRK::STYLE_ON, false);
+        }
+        printResult(backendName, numPixels, "setColorStyle(nowait)", ops, elapsedNs(start), backend.counts());
+    }
+
+    // Set one pixel and show immediately (the default)
+    {
+        uint64_t ops = 64 * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->setColorStyle((uint16_t)((ii * 7) % numPixels), colors[ii % colorsCount], StatusLedRK::STYLE_ON, true);
+        }
+        printResult(backendName, numPixels, "setColorStyle(show)", ops, elapsedNs(start), backend.counts());
+    }
+
+    // The same, one per millisecond, with refreshes limited to one per 20 ms and flushed by loop()
+    {
+        led->setFrameLimitMs(20);
+
+        uint64_t ops = 64 * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            HostMock::advanceMillis(1);
+            led->setColorStyle((uint16_t)((ii * 7) % numPixels), colors[ii % colorsCount], StatusLedRK::STYLE_ON, true);
+            led->loop();
+        }
+        printResult(backendName, numPixels, "setColorStyle(limited)", ops, elapsedNs(start), backend.counts());
+
+        led->setFrameLimitMs(0);
+        led->show();
+    }
+
+    // Set one pixel from the status table, equivalent to the setColorStyle(nowait) row
+    {
+        led->setStatusTable(benchStatuses, sizeof(benchStatuses) / sizeof(benchStatuses[0]));
+
+        uint64_t ops = numPixels * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->setStatus((uint16_t)(ii % numPixels), (uint16_t)(ii % colorsCount), false);
+        }
+        printResult(backendName, numPixels, "setStatus(nowait)", ops, elapsedNs(start), backend.counts());
+    }
+
+    // Repaint the whole strip with one call and one refresh
+    {
+        uint64_t ops = 16 * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->fill(colors[ii % colorsCount]);
+        }
+        printResult(backendName, numPixels, "fill", ops, elapsedNs(start), backend.counts());
+    }
+
+    // Repaint the whole strip from a stream, one frame (a fill and 4 runs) per call
+    {
+        StatusLedRK_StreamDecoder decoder(led);
+        HostMemoryStream stream;
+
+        uint64_t ops = 16 * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            uint32_t color = colors[ii % colorsCount];
+            uint8_t frame[] = {
+                StatusLedRK_StreamDecoder::FRAME_START,
+                StatusLedRK_StreamDecoder::CMD_FILL, 0, 0, (uint8_t) numPixels, (uint8_t)(numPixels >> 8), 
+                    (uint8_t)(color >> 16), (uint8_t)(color >> 8), (uint8_t) color, StatusLedRK::STYLE_ON,
+                StatusLedRK_StreamDecoder::CMD_RUNS, 0, 0, StatusLedRK::STYLE_ON, 4, 
+                    1, 0xff, 0, 0, 1, 0, 0xff, 0, 1, 0, 0, 0xff, 1, (uint8_t) ii, 0, 0,
+                StatusLedRK_StreamDecoder::CMD_END
+            };
+            stream.write(frame, sizeof(frame));
+            decoder.process(stream);
+        }
+        printResult(backendName, numPixels, "stream(frame)", ops, elapsedNs(start), backend.counts());
+    }
+
+    // The same with gamma and brightness applied at show() time
+    {
+        led->setGamma(2.2);
+        led->setBrightness(128);
+
+        uint64_t ops = 16 * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->fill(colors[ii % colorsCount]);
+        }
+        printResult(backendName, numPixels, "fill(gamma)", ops, elapsedNs(start), backend.counts());
+
+        led->setGamma(1.0);
+        led->setBrightness(255);
+    }
+
+    // Repaint pixel by pixel inside a transaction
+    {
+        uint64_t ops = 16 * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->beginUpdate();
+            for(size_t jj = 0; jj < numPixels; jj++) {
+                led->setColor((uint16_t)jj, colors[(ii + jj) % colorsCount]);
+            }
+            led->commit();
+        }
+        printResult(backendName, numPixels, "beginUpdate/commit", ops, elapsedNs(start), backend.counts());
+    }
+
+    // Explicit show() with nothing changed
+    {
+        uint64_t ops = 64 * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->show();
+        }
+        printResult(backendName, numPixels, "show", ops, elapsedNs(start), backend.counts());
+    }
+
+    // Full refresh of every pixel
+    {
+        uint64_t ops = 64 * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->showAll();
+        }
+        printResult(backendName, numPixels, "showAll", ops, elapsedNs(start), backend.counts());
+    }
+
+    // loop() with every pixel solid: nothing to do
+    {
+        uint64_t ops = 10000;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            HostMock::advanceMillis(1);
+            led->loop();
+        }
+        printResult(backendName, numPixels, "loop(solid)", ops, elapsedNs(start), backend.counts());
+    }
+
+    // loop() mirroring the system LED, which changes 16 times between calls (like breathing)
+    {
+        led->startSystemMirror(0);
+
+        uint64_t ops = 10000;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            for(uint8_t jj = 0; jj < 16; jj++) {
+                RGB.mockChange(0, (uint8_t)(ii + jj), 255);
+            }
+            HostMock::advanceMillis(1);
+            led->loop();
+        }
+        printResult(backendName, numPixels, "loop(mirror)", ops, elapsedNs(start), backend.counts());
+
+        led->stopSystemMirror();
+    }
+
+    // loop() with a mix of solid, blinking and overridden pixels, 1 ms per call for 10 seconds
+    {
+        setMixed(led);
+
+        uint64_t ops = 10000;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            HostMock::advanceMillis(1);
+            led->loop();
+        }
+        printResult(backendName, numPixels, "loop(mixed)", ops, elapsedNs(start), backend.counts());
+
+        size_t bytes = led->getMemoryUsage();
+        printf("%-8s %6u %-22s %10lu bytes %6.1f bytes/pixel\n", backendName, (unsigned) numPixels, "memory(mixed)", 
+            (unsigned long) bytes, (double) bytes / (double) numPixels);
+    }
+
+    // The same mix with synchronized blinking
+    {
+        led->setBlinkSync(true);
+        setMixed(led);
+
+        uint64_t ops = 10000;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            HostMock::advanceMillis(1);
+            led->loop();
+        }
+        printResult(backendName, numPixels, "loop(mixed,sync)", ops, elapsedNs(start), backend.counts());
+
+        led->setBlinkSync(false);
+    }
+
+    // Save and restore a snapshot of the same mix
+    {
+        setMixed(led);
+        std::vector<uint8_t> snapshot(led->getSnapshotSize());
+
+        uint64_t ops = 16 * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->saveSnapshot(snapshot.data(), snapshot.size());
+        }
+        printResult(backendName, numPixels, "saveSnapshot", ops, elapsedNs(start), backend.counts());
+
+        backend.resetCounts();
+        start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->restoreSnapshot(snapshot.data(), snapshot.size());
+        }
+        printResult(backendName, numPixels, "restoreSnapshot", ops, elapsedNs(start), backend.counts());
+    }
+
+    // The same mix driven by a manual clock, 10 ms per call for 100 seconds
+    {
+        StatusLedRK_ManualClock clock(millis());
+        led->setClock(&clock);
+        setMixed(led);
+
+        uint64_t ops = 10000;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            clock.advance(10);
+            led->loop();
+        }
+        printResult(backendName, numPixels, "loop(mixed,clock)", ops, elapsedNs(start), backend.counts());
+
+        HostMock::setMillis(clock.getMillis());
+        led->setClock(0);
+    }
+
+    // loop() with one pixel in 8 breathing and the rest solid
+    {
+        led->beginUpdate();
+        led->fill(StatusLedRK::COLOR_BLACK, StatusLedRK::STYLE_ON, false);
+        for(size_t ii = 0; ii < numPixels; ii += 8) {
+            led->setColorPattern((uint16_t)ii, colors[ii % colorsCount], &StatusLedRK::PATTERN_BREATHE, false);
+        }
+        led->commit();
+
+        uint64_t ops = 10000;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            HostMock::advanceMillis(1);
+            led->loop();
+        }
+        printResult(backendName, numPixels, "loop(pattern)", ops, elapsedNs(start), backend.counts());
+
+        led->fill(StatusLedRK::COLOR_BLACK);
+    }
+
+    // loop() with three override layers on every pixel, expiring at different times
+    {
+        led->fill(StatusLedRK::COLOR_BLACK);
+        led->setOverrideRange(0, (uint16_t)numPixels, StatusLedRK::COLOR_RED, StatusLedRK::STYLE_BLINK_SLOW, 9000, false, 0);
+        led->setOverrideRange(0, (uint16_t)numPixels, StatusLedRK::COLOR_GREEN, StatusLedRK::STYLE_ON, 6000, false, 1);
+        led->setOverrideRange(0, (uint16_t)numPixels, StatusLedRK::COLOR_BLUE, StatusLedRK::STYLE_BLINK_FAST, 3000, false, 2);
+
+        uint64_t ops = 10000;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            HostMock::advanceMillis(1);
+            led->loop();
+        }
+        printResult(backendName, numPixels, "loop(layered)", ops, elapsedNs(start), backend.counts());
+    }
+
+    // setOverrideRange() on the whole strip
+    {
+        uint64_t ops = 16 * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->setOverrideRange(0, (uint16_t)numPixels, colors[ii % colorsCount], StatusLedRK::STYLE_ON, 1000);
+        }
+        printResult(backendName, numPixels, "setOverrideRange", ops, elapsedNs(start), backend.counts());
+    }
+
+    // setOverrideStyle() on every pixel
+    {
+        uint64_t ops = numPixels;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->setOverrideStyle((uint16_t)ii, StatusLedRK::COLOR_RED, StatusLedRK::STYLE_ON, 1000);
+        }
+        printResult(backendName, numPixels, "setOverrideStyle", ops, elapsedNs(start), backend.counts());
+    }
+
+    // Setters with the worker thread running, so every call takes the lock
+    {
+        led->startThread();
+
+        uint64_t ops = numPixels * opScale;
+        backend.resetCounts();
+        Clock::time_point start = Clock::now();
+        for(uint64_t ii = 0; ii < ops; ii++) {
+            led->setColorStyle((uint16_t)(ii % numPixels), colors[ii % colorsCount], StatusLedRK::STYLE_BLINK_FAST, false);
+        }
+        printResult(backendName, numPixels, "setColorStyle(thread)", ops, elapsedNs(start), backend.counts());
+
+        led->stopThread();
+    }
+
+#if STATUSLEDRK_ENABLE_STATS
+    // Totals for all of the rows of this backend
+    printf("%s %u:\n", backendName, (unsigned) numPixels);
+    led->logStats();
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    size_t maxPixels = 4096;
+    if (argc > 1) {
+        maxPixels = (size_t) strtoul(argv[1], NULL, 0);
+    }
+
+    printHeader();
+
+    for(size_t numPixels : pixelCounts) {
+        if (numPixels > maxPixels) {
+            break;
+        }
+        // Keep the total work per row roughly constant so small strips are not lost in timer noise
+        uint64_t opScale = (numPixels < 256) ? (256 / numPixels) : 1;
+
+        {
+            BackendRGB backend(numPixels);
+            runBackend("rgb", backend, opScale);
+        }
+        {
+            BackendNeopixel backend(numPixels);
+            runBackend("neopixel", backend, opScale);
+        }
+        {
+            std::unique_ptr<BackendNeopixelStatic> backend(new BackendNeopixelStatic(numPixels));
+            runBackend("neo-stat", *backend, opScale);
+        }
+        {
+            BackendComposite backend(numPixels);
+            runBackend("neo+pca", backend, opScale);
+        }
+        if (numPixels >= 8) {
+            // The pixels column is the number of groups of 8
+            BackendGroups backend(numPixels);
+            runBackend("neo-grp8", backend, opScale);
+        }
+    }
+
+    {
+        BackendPCA9531 backend;
+        runBackend("pca9531", backend, 32);
+    }
+
+    return 0;
+}
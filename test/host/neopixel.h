@@ -0,0 +1,96 @@
+#ifndef PARTICLE_NEOPIXEL_H
+#define PARTICLE_NEOPIXEL_H
+
+// Host stand-in for the Particle-NeoPixel library (https://github.com/technobly/Particle-NeoPixel).
+// Keeps a pixel buffer in the strip's native byte order and counts calls
+// instead of driving a GPIO.
+
+#include "Particle.h"
+
+#define WS2812 0x02
+#define WS2812B 0x02
+#define WS2811 0x00
+#define SK6812RGBW 0x06
+
+class Adafruit_NeoPixel {
+public:
+    Adafruit_NeoPixel(uint16_t n, pin_t p = 2, uint8_t t = WS2812B) : numLEDs(n), numBytes(n * ((t == SK6812RGBW) ? 4 : 3)), pin(p), type(t) {
+        pixels = new uint8_t[numBytes];
+        memset(pixels, 0, numBytes);
+    }
+    ~Adafruit_NeoPixel() {
+        delete[] pixels;
+    }
+
+    void begin() {
+        pinMode(pin, OUTPUT);
+    }
+
+    void show() {
+        showCount++;
+    }
+
+    void setPixelColor(uint16_t n, uint32_t c) {
+        setPixelColorCount++;
+        if (n < numLEDs) {
+            uint8_t r = (uint8_t)(c >> 16), g = (uint8_t)(c >> 8), b = (uint8_t)c;
+            if (brightness) {
+                r = (r * brightness) >> 8;
+                g = (g * brightness) >> 8;
+                b = (b * brightness) >> 8;
+            }
+            uint8_t *p = &pixels[n * numBytes / numLEDs];
+            if (type == WS2811) {
+                p[0] = r;
+                p[1] = g;
+                p[2] = b;
+            }
+            else {
+                p[0] = g; // WS2812B is GRB, SK6812RGBW is GRBW
+                p[1] = r;
+                p[2] = b;
+            }
+            if (type == SK6812RGBW) {
+                p[3] = (uint8_t)(c >> 24);
+            }
+        }
+    }
+
+    uint32_t getPixelColor(uint16_t n) const {
+        if (n >= numLEDs) {
+            return 0;
+        }
+        const uint8_t *p = &pixels[n * numBytes / numLEDs];
+        if (type == WS2811) {
+            return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | (uint32_t)p[2];
+        }
+        return ((uint32_t)p[1] << 16) | ((uint32_t)p[0] << 8) | (uint32_t)p[2];
+    }
+
+    // Like the real library, brightness is stored plus one so 0 means not scaled
+    void setBrightness(uint8_t b) { brightness = b + 1; }
+    uint8_t getBrightness() const { return brightness - 1; }
+
+    uint8_t *getPixels() const { return pixels; }
+    uint16_t getNumBytes() const { return numBytes; } //!< Size of the buffer from getPixels() (mock only)
+    uint16_t getNumLeds() const { return numLEDs; }
+    uint16_t numPixels() const { return numLEDs; }
+
+    uint32_t showCount = 0; //!< Number of calls to show() (mock only)
+    uint32_t setPixelColorCount = 0; //!< Number of calls to setPixelColor() (mock only)
+
+    void resetCounters() {
+        showCount = 0;
+        setPixelColorCount = 0;
+    }
+
+protected:
+    uint16_t numLEDs;
+    uint16_t numBytes;
+    pin_t pin;
+    uint8_t type;
+    uint8_t brightness = 0;
+    uint8_t *pixels;
+};
+
+#endif // PARTICLE_NEOPIXEL_H
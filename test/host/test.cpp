@@ -0,0 +1,1407 @@
+// Host tests for StatusLedRK
+//
+// Builds the library against the stand-in Particle.h in this directory and checks the
+// pixel colors each backend receives. Time is driven by StatusLedRK_ManualClock (or the
+// mock millis()) so the tests run instantly and always get the same result.
+//
+// Usage: ./test_host
+// Exits with a non-zero status if any check fails.
+
+#include "Particle.h"
+
+#include "neopixel.h" // Must be before StatusLedRK.h
+#include "PCA9531_RK.h" // Must be before StatusLedRK.h
+
+#include "StatusLedRK.h"
+
+#include <new>
+#include <vector>
+
+// Counts heap allocations so the tests can check that StatusLedRK_Static doesn't allocate
+static std::atomic<uint32_t> allocCount(0);
+
+// When this counts down to 0, new returns NULL as it does on Device OS when out of memory.
+// The library is built with -fcheck-new so the result is checked like it is on the device.
+static std::atomic<int> failAllocAfter(-1);
+
+// The replacements are noinline so GCC doesn't see free() inlined at a new expression and
+// report -Wmismatched-new-delete. They all use malloc() and free() so the sanitizers still match them.
+__attribute__((noinline)) void *operator new(size_t size) {
+    allocCount++;
+    if (failAllocAfter >= 0 && failAllocAfter-- == 0) {
+        return 0;
+    }
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+
+static int checkCount = 0;
+static int failCount = 0;
+static const char *currentTest = "";
+
+static void checkEqual(uint32_t actual, uint32_t expected, const char *actualStr, const char *expectedStr, int line) {
+    checkCount++;
+    if (actual != expected) {
+        failCount++;
+        printf("FAIL %s line %d: %s is 0x%06lx, expected %s (0x%06lx)\n", currentTest, line,
+            actualStr, (unsigned long) actual, expectedStr, (unsigned long) expected);
+    }
+}
+
+#define CHECK_EQUAL(actual, expected) checkEqual((uint32_t)(actual), (uint32_t)(expected), #actual, #expected, __LINE__)
+#define CHECK(cond) CHECK_EQUAL((cond) ? 1 : 0, 1)
+
+static const uint32_t RED = StatusLedRK::COLOR_RED;
+static const uint32_t GREEN = StatusLedRK::COLOR_GREEN;
+static const uint32_t BLUE = StatusLedRK::COLOR_BLUE;
+static const uint32_t WHITE = StatusLedRK::COLOR_WHITE;
+
+typedef StatusLedRK_StreamDecoder Decoder;
+
+/**
+ * @brief NeoPixel backend that exposes the counters and deadline heap used by loop()
+ */
+class InspectNeopixel : public StatusLedRK_Neopixel {
+public:
+    InspectNeopixel(Adafruit_NeoPixel *strip) : StatusLedRK_Neopixel(strip) {}
+
+    size_t getBlinkingCount() const { return blinkingCount; }
+    bool getLoopCheckEnabled() const { return loopCheckEnabled; }
+    size_t getHeapSize() const { return heapSize; }
+    bool isScheduled(uint16_t n) const { return heapPos[n] != HEAP_POS_NONE; }
+};
+
+/**
+ * @brief A NeoPixel strip driven by a manual clock, set up and ready to use
+ */
+class NeoFixture {
+public:
+    NeoFixture(uint16_t numPixels = 8, uint32_t startMs = 100000) : strip(numPixels, 0, WS2812B), led(&strip), clock(startMs) {
+        led.setClock(&clock);
+        led.setup();
+    }
+
+    /**
+     * @brief Advance the clock and call loop()
+     */
+    void run(uint32_t ms) {
+        clock.advance(ms);
+        led.loop();
+    }
+
+    /**
+     * @brief Advance the clock 1 ms at a time, calling loop() each time
+     */
+    void runEach(uint32_t ms) {
+        for(uint32_t ii = 0; ii < ms; ii++) {
+            run(1);
+        }
+    }
+
+    uint32_t pixel(uint16_t n) const { return strip.getPixelColor(n); }
+
+    Adafruit_NeoPixel strip;
+    InspectNeopixel led;
+    StatusLedRK_ManualClock clock;
+};
+
+static void testBlinkPhase() {
+    NeoFixture f;
+
+    f.led.setColorStyle(0, RED, StatusLedRK::STYLE_BLINK_SLOW);
+    f.led.setColorStyle(1, GREEN, StatusLedRK::STYLE_BLINK_FAST);
+    f.led.setColorStyle(2, BLUE, StatusLedRK::STYLE_ON);
+    f.run(0);
+
+    // Blinking starts in the on state
+    CHECK_EQUAL(f.pixel(0), RED);
+    CHECK_EQUAL(f.pixel(1), GREEN);
+    CHECK_EQUAL(f.pixel(2), BLUE);
+
+    f.runEach(249);
+    CHECK_EQUAL(f.pixel(1), GREEN);
+    f.run(1);
+    CHECK_EQUAL(f.pixel(1), 0);
+    f.run(250);
+    CHECK_EQUAL(f.pixel(1), GREEN);
+
+    f.runEach(499);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.run(1);
+    CHECK_EQUAL(f.pixel(0), 0);
+    CHECK_EQUAL(f.pixel(2), BLUE);
+    f.run(1000);
+    CHECK_EQUAL(f.pixel(0), RED);
+
+    // When loop() is called late, the next change is a full interval after the late one
+    f.run(1300);
+    CHECK_EQUAL(f.pixel(0), 0);
+    f.run(700);
+    CHECK_EQUAL(f.pixel(0), 0);
+    f.run(300);
+    CHECK_EQUAL(f.pixel(0), RED);
+
+    // Stopping the blink shows the color steadily
+    f.led.setColorStyle(0, RED, StatusLedRK::STYLE_ON);
+    f.run(1000);
+    CHECK_EQUAL(f.pixel(0), RED);
+}
+
+static void testBlinkRestart() {
+    NeoFixture f;
+
+    // Blinking stopped while the pixel was on...
+    f.led.setColorStyle(0, RED, StatusLedRK::STYLE_BLINK_SLOW);
+    f.run(0);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.led.setColorStyle(0, RED, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(f.pixel(0), RED);
+
+    // ...starts again with the same phase as the first time
+    f.run(3000);
+    f.led.setColorStyle(0, RED, StatusLedRK::STYLE_BLINK_SLOW);
+    f.run(0);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.run(999);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.run(1);
+    CHECK_EQUAL(f.pixel(0), 0);
+    f.run(1000);
+    CHECK_EQUAL(f.pixel(0), RED);
+}
+
+static void testManualClock() {
+    // millis() is frozen; only the manual clock moves, and it rolls over during the test
+    HostMock::setMillis(5);
+    NeoFixture f(4, 0xfffffe00);
+
+    f.led.setColorStyle(0, RED, StatusLedRK::STYLE_BLINK_FAST);
+    f.led.setOverrideStyle(1, WHITE, StatusLedRK::STYLE_ON, 1000);
+    f.led.setColorPattern(2, BLUE, &StatusLedRK::PATTERN_FADE_IN);
+    f.run(0);
+    CHECK_EQUAL(f.pixel(0), RED);
+    CHECK_EQUAL(f.pixel(1), WHITE);
+    CHECK_EQUAL(f.pixel(2), 0);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 20);
+
+    // Without loop() nothing changes, however much time passes
+    f.clock.advance(300);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.led.loop();
+    CHECK_EQUAL(f.pixel(0), 0);
+    CHECK_EQUAL(f.pixel(2), 0x00004b);
+
+    f.run(200);
+    CHECK_EQUAL(f.pixel(0), 0);
+    CHECK_EQUAL(f.pixel(2), 0x000080);
+
+    // Past the rollover
+    f.run(300);
+    CHECK(f.clock.getMillis() < 0x1000);
+    CHECK_EQUAL(f.pixel(0), RED);
+    CHECK_EQUAL(f.pixel(1), WHITE);
+
+    f.run(200);
+    CHECK_EQUAL(f.pixel(0), RED);
+    CHECK_EQUAL(f.pixel(1), 0);
+    CHECK_EQUAL(f.pixel(2), BLUE);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 50);
+
+    f.run(50);
+    CHECK_EQUAL(f.pixel(0), 0);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 250);
+    CHECK_EQUAL(HostMock::millisValue, 5);
+}
+
+static void testResync() {
+    NeoFixture f;
+
+    f.led.setColorStyle(0, GREEN, StatusLedRK::STYLE_ON);
+    f.led.setOverrideStyle(0, RED, StatusLedRK::STYLE_BLINK_FAST, 60000, false);
+    f.led.setColorStyle(1, BLUE, StatusLedRK::STYLE_BLINK_FAST);
+    f.led.setColorStyle(2, GREEN, StatusLedRK::STYLE_ON);
+    f.led.setOverrideStyle(2, WHITE, StatusLedRK::STYLE_BLINK_SLOW, 60000, false);
+    f.led.setColorStyle(3, WHITE, StatusLedRK::STYLE_BLINK_SLOW);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 0);
+
+    // Asleep from the moment they were set. Fast blinks changed at 0, 250, 500, 750 and 
+    // 1000 ms so they're on; slow blinks changed at 0 and 1000 ms so they're off.
+    f.clock.advance(1100);
+    f.led.resync();
+    CHECK_EQUAL(f.pixel(0), RED);
+    CHECK_EQUAL(f.pixel(1), BLUE);
+    CHECK_EQUAL(f.pixel(2), 0);
+    CHECK_EQUAL(f.pixel(3), 0);
+
+    // The phase continues after the catch up
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 150);
+    f.run(149);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.run(1);
+    CHECK_EQUAL(f.pixel(0), 0);
+    CHECK_EQUAL(f.pixel(1), 0);
+    f.run(750);
+    CHECK_EQUAL(f.pixel(2), WHITE);
+    CHECK_EQUAL(f.pixel(3), WHITE);
+
+    // A layer revealed while asleep blinks from when the layer above it expired
+    NeoFixture f2;
+    f2.led.setColorStyle(0, GREEN, StatusLedRK::STYLE_ON);
+    f2.led.setOverrideStyle(0, BLUE, StatusLedRK::STYLE_BLINK_FAST, 10000, false, 0);
+    f2.led.setOverrideStyle(0, RED, StatusLedRK::STYLE_ON, 500, false, 5);
+    f2.run(0);
+    CHECK_EQUAL(f2.pixel(0), RED);
+
+    // On at 500, 1000 ms, off at 750, 1250 ms
+    f2.clock.advance(1300);
+    f2.led.resync();
+    CHECK_EQUAL(f2.pixel(0), 0);
+    f2.run(200);
+    CHECK_EQUAL(f2.pixel(0), BLUE);
+}
+
+static const StatusLedRK::Keyframe stepKeyframes[] = {
+    { StatusLedRK::COLOR_RED, 500, StatusLedRK::EASING_STEP },
+    { StatusLedRK::COLOR_GREEN, 300, StatusLedRK::EASING_STEP },
+    { StatusLedRK::COLOR_BLUE, 200, StatusLedRK::EASING_STEP }
+};
+static const StatusLedRK::Pattern stepPattern = { stepKeyframes, 3, true };
+
+static void testPatternSteps() {
+    NeoFixture f;
+
+    // Held keyframes are only checked when they change
+    f.led.setColorPattern(0, WHITE, &stepPattern);
+    CHECK_EQUAL(f.pixel(0), RED);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 500);
+
+    f.run(499);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.run(1);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 300);
+    f.run(300);
+    CHECK_EQUAL(f.pixel(0), BLUE);
+    f.run(200);
+    CHECK_EQUAL(f.pixel(0), RED);
+
+    // A late loop() shows the keyframe for the current time, and the timing is kept
+    f.run(1650);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 150);
+
+    // Setting the same pattern again does not restart it
+    f.led.setColorPattern(0, BLUE, &stepPattern);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 150);
+}
+
+static void testPatternEasing() {
+    // Fade from black to red over 1000 ms. Expected red at 250 and 500 ms.
+    static const struct {
+        uint8_t easing;
+        uint32_t quarter;
+        uint32_t half;
+    } curves[] = {
+        { StatusLedRK::EASING_LINEAR, 0x3f0000, 0x800000 },
+        { StatusLedRK::EASING_SINE, 0x250000, 0x800000 },
+        { StatusLedRK::EASING_IN, 0x0f0000, 0x3f0000 },
+        { StatusLedRK::EASING_OUT, 0x700000, 0xc00000 }
+    };
+
+    for(size_t ii = 0; ii < sizeof(curves) / sizeof(curves[0]); ii++) {
+        NeoFixture f;
+        const StatusLedRK::Keyframe keyframes[2] = {
+            { 0x000000, 1000, curves[ii].easing },
+            { RED, 0, StatusLedRK::EASING_STEP }
+        };
+        const StatusLedRK::Pattern pattern = { keyframes, 2, false };
+
+        f.led.setColorPattern(0, WHITE, &pattern);
+        CHECK_EQUAL(f.pixel(0), 0);
+        f.run(250);
+        CHECK_EQUAL(f.pixel(0), curves[ii].quarter);
+        f.run(250);
+        CHECK_EQUAL(f.pixel(0), curves[ii].half);
+        f.run(500);
+        CHECK_EQUAL(f.pixel(0), RED);
+    }
+}
+
+static void testPatternBuiltIn() {
+    NeoFixture f;
+
+    // Breathing fades between off and the pixel color, and repeats
+    f.led.setColorPattern(0, BLUE, &StatusLedRK::PATTERN_BREATHE);
+    CHECK_EQUAL(f.pixel(0), 0);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(0), 0x000080);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(0), BLUE);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(0), 0x00007e);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(0), 0);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(0), 0x000080);
+
+    // A new color is used right away, without restarting the pattern
+    f.led.setColorPattern(0, RED, &StatusLedRK::PATTERN_BREATHE);
+    CHECK_EQUAL(f.pixel(0), 0x800000);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(0), RED);
+
+    f.led.setColorPattern(1, GREEN, &StatusLedRK::PATTERN_FADE_IN);
+    f.led.setColorPattern(2, RED, &StatusLedRK::PATTERN_FADE_OUT);
+    CHECK_EQUAL(f.pixel(1), 0);
+    CHECK_EQUAL(f.pixel(2), RED);
+    f.run(250);
+    CHECK_EQUAL(f.pixel(1), 0x002000);
+    CHECK_EQUAL(f.pixel(2), 0xbf0000);
+    f.run(750);
+    CHECK_EQUAL(f.pixel(1), GREEN);
+    CHECK_EQUAL(f.pixel(2), 0);
+
+    // Finished patterns are not in the deadline heap; only the breathing pixel is
+    CHECK(f.led.isScheduled(0));
+    CHECK(!f.led.isScheduled(1));
+    CHECK(!f.led.isScheduled(2));
+    CHECK_EQUAL(f.led.getHeapSize(), 1);
+
+    // Changing to a solid color ends the pattern
+    f.led.setColor(0, WHITE);
+    CHECK_EQUAL(f.pixel(0), WHITE);
+    CHECK_EQUAL(f.led.getHeapSize(), 0);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), StatusLedRK::NO_EVENT);
+}
+
+static void testPatternFrameRate() {
+    NeoFixture f;
+
+    f.led.setPatternFrameMs(100);
+    f.led.setColorPattern(0, RED, &StatusLedRK::PATTERN_FADE_IN);
+    CHECK_EQUAL(f.pixel(0), 0);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 100);
+
+    // Nothing is shown between frames
+    f.strip.resetCounters();
+    f.runEach(99);
+    CHECK_EQUAL(f.strip.showCount, 0);
+    CHECK_EQUAL(f.pixel(0), 0);
+    f.run(1);
+    CHECK_EQUAL(f.strip.showCount, 1);
+    CHECK_EQUAL(f.pixel(0), 0x180000);
+
+    // The last frame is at the end of the fade, not a full frame later
+    f.run(850);
+    CHECK_EQUAL(f.pixel(0), 0xf30000);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 50);
+    f.run(50);
+    CHECK_EQUAL(f.pixel(0), RED);
+
+    // A finished pattern is never rescheduled, so loop() doesn't show anything
+    CHECK(!f.led.isScheduled(0));
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), StatusLedRK::NO_EVENT);
+    uint32_t shows = f.strip.showCount;
+    f.runEach(5000);
+    CHECK_EQUAL(f.strip.showCount, shows);
+    CHECK_EQUAL(f.pixel(0), RED);
+}
+
+static void testFrameLimit() {
+    NeoFixture f;
+    f.led.setFrameLimitMs(50);
+
+    // The first change is shown right away, and a burst within the limit is one more refresh
+    f.strip.resetCounters();
+    f.led.setColorStyle(0, RED, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(f.strip.showCount, 1);
+    CHECK_EQUAL(f.pixel(0), RED);
+    for(uint16_t ii = 1; ii < 8; ii++) {
+        f.clock.advance(1);
+        f.led.setColorStyle(ii, GREEN, StatusLedRK::STYLE_ON);
+    }
+    CHECK_EQUAL(f.strip.showCount, 1);
+    CHECK_EQUAL(f.pixel(7), 0);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 43);
+
+    // loop() shows the deferred changes when the interval ends
+    f.run(42);
+    CHECK_EQUAL(f.strip.showCount, 1);
+    f.run(1);
+    CHECK_EQUAL(f.strip.showCount, 2);
+    CHECK_EQUAL(f.pixel(1), GREEN);
+    CHECK_EQUAL(f.pixel(7), GREEN);
+    f.run(100);
+    CHECK_EQUAL(f.strip.showCount, 2);
+
+    // show() bypasses the limit, and the limit then counts from that refresh
+    f.led.setColorStyle(0, BLUE, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(f.strip.showCount, 3);
+    f.clock.advance(10);
+    f.led.setColorStyle(1, BLUE, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(f.strip.showCount, 3);
+    f.led.show();
+    CHECK_EQUAL(f.strip.showCount, 4);
+    CHECK_EQUAL(f.pixel(1), BLUE);
+
+    f.clock.advance(45);
+    f.led.setColorStyle(2, BLUE, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(f.strip.showCount, 4);
+    f.run(4);
+    CHECK_EQUAL(f.strip.showCount, 4);
+    f.run(1);
+    CHECK_EQUAL(f.strip.showCount, 5);
+    CHECK_EQUAL(f.pixel(2), BLUE);
+}
+
+static void testBrightnessGamma() {
+    NeoFixture f;
+    size_t memoryUsage = f.led.getMemoryUsage();
+
+    // By default colors are written unchanged, and the lookup table is not allocated
+    f.led.setColor(0, 0x4080c0);
+    f.led.setColor(1, WHITE);
+    CHECK_EQUAL(f.pixel(0), 0x4080c0);
+    CHECK_EQUAL(f.led.getMemoryUsage(), memoryUsage);
+
+    f.led.setBrightness(128);
+    CHECK_EQUAL(f.pixel(0), 0x204060);
+    CHECK_EQUAL(f.pixel(1), 0x808080);
+    CHECK_EQUAL(f.led.getColorWithOverride(0), 0x4080c0);
+    CHECK_EQUAL(f.led.getMemoryUsage(), memoryUsage + 3 * 256);
+
+    // Overrides are corrected too
+    f.led.setOverrideStyle(2, 0x4080c0, StatusLedRK::STYLE_ON, 1000);
+    CHECK_EQUAL(f.pixel(2), 0x204060);
+    CHECK_EQUAL(f.led.getColorWithOverride(2), 0x4080c0);
+
+    f.led.setBrightness(255);
+    f.led.setGamma(2.2);
+    CHECK_EQUAL(f.pixel(0), 0x0c3889);
+    CHECK_EQUAL(f.pixel(1), WHITE);
+    f.led.setGamma(2.2, 1.0, 2.8);
+    CHECK_EQUAL(f.pixel(0), 0x0c8073);
+    CHECK_EQUAL(f.led.getColorWithOverride(0), 0x4080c0);
+
+    // Back to no correction
+    f.led.setGamma(1.0);
+    CHECK_EQUAL(f.pixel(0), 0x4080c0);
+    CHECK_EQUAL(f.pixel(2), 0x4080c0);
+
+    // Pixel brightness is combined with the global brightness
+    f.led.setPixelBrightness(0, 128);
+    f.led.setPixelBrightness(1, 0);
+    CHECK_EQUAL(f.pixel(0), 0x204060);
+    CHECK_EQUAL(f.pixel(1), 0);
+    CHECK_EQUAL(f.pixel(2), 0x4080c0);
+    f.led.setBrightness(128);
+    CHECK_EQUAL(f.pixel(0), 0x102030);
+    CHECK_EQUAL(f.pixel(2), 0x204060);
+
+    // ...and applied before gamma
+    f.led.setBrightness(255);
+    f.led.setGamma(2.2);
+    f.led.setColor(0, WHITE);
+    CHECK_EQUAL(f.pixel(0), 0x383838);
+    CHECK_EQUAL(f.led.getColorWithOverride(0), WHITE);
+    CHECK_EQUAL(f.led.getColorWithOverride(1), WHITE);
+
+    // The values written to the PWM pins of an RGB LED
+    static const StatusLedRK_RGB::LedPins pins[1] = { { 20, 21, 22 } };
+    StatusLedRK_RGB rgb(1, pins, false);
+    rgb.setup();
+    rgb.setBrightness(128);
+    rgb.setColor(0, 0x4080c0);
+    CHECK_EQUAL(HostMock::pinValue[20], 0x20);
+    CHECK_EQUAL(HostMock::pinValue[21], 0x40);
+    CHECK_EQUAL(HostMock::pinValue[22], 0x60);
+    CHECK_EQUAL(rgb.getColorWithOverride(0), 0x4080c0);
+}
+
+static void testNeopixelBuffer() {
+    static const uint32_t testColors[5] = { 0x123456, 0xff0000, 0x00ff00, 0x0000ff, 0xfedcba };
+    static const struct {
+        uint8_t type;
+        uint16_t numPixels;
+        int brightnessBefore; //!< Strip brightness set before setup(), or -1
+        int brightnessAfter; //!< Strip brightness set after setup(), or -1
+        bool direct; //!< Expect the colors to be written directly into the strip buffer
+    } cases[] = {
+        { WS2811, 5, -1, -1, true }, // RGB
+        { WS2812B, 5, -1, -1, true }, // GRB
+        { SK6812RGBW, 5, -1, -1, true }, // GRBW, 4 bytes per pixel
+        { WS2812B, 5, -1, 100, true }, // Strip brightness is applied when writing the buffer
+        { SK6812RGBW, 5, -1, 100, true },
+        { WS2812B, 5, 100, -1, false }, // The byte order can't be found from scaled values
+        { WS2811, 1, -1, -1, false } // The byte order can't be found from one pixel
+    };
+
+    for(size_t ii = 0; ii < sizeof(cases) / sizeof(cases[0]); ii++) {
+        uint16_t numPixels = cases[ii].numPixels;
+        Adafruit_NeoPixel strip(numPixels, 0, cases[ii].type), expected(numPixels, 0, cases[ii].type);
+        StatusLedRK_Neopixel led(&strip);
+        StatusLedRK_ManualClock clock(1000);
+        led.setClock(&clock);
+
+        if (cases[ii].brightnessBefore >= 0) {
+            strip.setBrightness((uint8_t)cases[ii].brightnessBefore);
+            expected.setBrightness((uint8_t)cases[ii].brightnessBefore);
+        }
+        led.setup();
+        if (cases[ii].brightnessAfter >= 0) {
+            strip.setBrightness((uint8_t)cases[ii].brightnessAfter);
+            expected.setBrightness((uint8_t)cases[ii].brightnessAfter);
+        }
+
+        strip.resetCounters();
+        for(uint16_t jj = 0; jj < numPixels; jj++) {
+            led.setColor(jj, testColors[jj], false);
+            expected.setPixelColor(jj, testColors[jj]);
+        }
+        led.show();
+        CHECK_EQUAL(strip.showCount, 1);
+        CHECK_EQUAL(strip.setPixelColorCount, cases[ii].direct ? 0 : numPixels);
+        CHECK(memcmp(strip.getPixels(), expected.getPixels(), expected.getNumBytes()) == 0);
+
+        // Changes after the first show are written the same way
+        led.setColor(numPixels - 1, 0x010203);
+        expected.setPixelColor(numPixels - 1, 0x010203);
+        CHECK(memcmp(strip.getPixels(), expected.getPixels(), expected.getNumBytes()) == 0);
+    }
+}
+
+static void testOverrideExpiry() {
+    NeoFixture f;
+
+    f.led.setColorStyle(0, GREEN, StatusLedRK::STYLE_ON);
+    f.led.setOverrideStyle(0, RED, StatusLedRK::STYLE_ON, 500);
+    CHECK_EQUAL(f.pixel(0), RED);
+    CHECK_EQUAL(f.led.getColorWithOverride(0), RED);
+    CHECK_EQUAL(f.led.getMillisUntilNextEvent(), 500);
+
+    f.run(499);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.run(1);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+    CHECK_EQUAL(f.led.getColorWithOverride(0), GREEN);
+
+    // Changing the pixel removes a clearOnChange override
+    f.led.setOverrideStyle(0, WHITE, StatusLedRK::STYLE_ON, 10000, true);
+    CHECK_EQUAL(f.pixel(0), WHITE);
+    f.led.setColorStyle(0, BLUE, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(f.pixel(0), BLUE);
+
+    // ...but not one without clearOnChange
+    f.led.setOverrideStyle(0, WHITE, StatusLedRK::STYLE_ON, 10000, false);
+    f.led.setColorStyle(0, GREEN, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(f.pixel(0), WHITE);
+    f.run(10000);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+}
+
+static void testOverrideLayers() {
+    NeoFixture f;
+
+    f.led.setColorStyle(0, GREEN, StatusLedRK::STYLE_ON);
+    f.led.setOverrideStyle(0, BLUE, StatusLedRK::STYLE_ON, 2000, false, 0);
+    f.led.setOverrideStyle(0, RED, StatusLedRK::STYLE_ON, 500, false, 5);
+    CHECK_EQUAL(f.pixel(0), RED);
+
+    // A lower priority layer is hidden until the higher one ends
+    f.led.setOverrideStyle(0, WHITE, StatusLedRK::STYLE_ON, 1000, false, 2);
+    CHECK_EQUAL(f.pixel(0), RED);
+
+    f.run(500);
+    CHECK_EQUAL(f.pixel(0), WHITE);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(0), BLUE);
+    f.run(1000);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+
+    // Same priority replaces the layer
+    f.led.setOverrideStyle(0, BLUE, StatusLedRK::STYLE_ON, 1000, false, 1);
+    f.led.setOverrideStyle(0, RED, StatusLedRK::STYLE_ON, 300, false, 1);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.run(300);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+}
+
+enum { STATUS_OK, STATUS_LOW_BATTERY, STATUS_BREATHE, STATUS_BUTTON, STATUS_ALERT, STATUS_COUNT };
+
+static const StatusLedRK::StatusDefinition statusTable[STATUS_COUNT] = {
+    { "ok", GREEN, StatusLedRK::STYLE_ON, nullptr, 0, 0, false },
+    { "lowBattery", RED, StatusLedRK::STYLE_BLINK_SLOW, nullptr, 0, 0, false },
+    { "breathe", BLUE, StatusLedRK::STYLE_PATTERN, &StatusLedRK::PATTERN_BREATHE, 0, 0, false },
+    { "button", WHITE, StatusLedRK::STYLE_ON, nullptr, 500, 1, false },
+    { nullptr, RED, StatusLedRK::STYLE_ON, nullptr, 300, 5, true },
+};
+
+static void testStatusTable() {
+    NeoFixture f;
+
+    // Without a table every status ID is out of range
+    f.led.setStatus(0, STATUS_OK);
+    CHECK_EQUAL(f.pixel(0), 0);
+    CHECK(strcmp(f.led.getStatusName(STATUS_OK), "") == 0);
+
+    f.led.setStatusTable(statusTable, STATUS_COUNT);
+    CHECK(strcmp(f.led.getStatusName(STATUS_LOW_BATTERY), "lowBattery") == 0);
+    CHECK(strcmp(f.led.getStatusName(STATUS_ALERT), "") == 0);
+    CHECK(strcmp(f.led.getStatusName(STATUS_COUNT), "") == 0);
+
+    // Entries without howLong set the color and style or pattern of the pixel
+    f.led.setStatus(0, STATUS_OK);
+    f.led.setStatus(1, STATUS_LOW_BATTERY);
+    f.led.setStatus(2, STATUS_BREATHE);
+    f.run(0);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+    CHECK_EQUAL(f.pixel(1), RED);
+    CHECK_EQUAL(f.pixel(2), 0);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(2), 0x000080);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+    CHECK_EQUAL(f.pixel(1), 0);
+    CHECK_EQUAL(f.pixel(2), BLUE);
+
+    // Out of range status IDs are ignored
+    f.led.setStatus(0, STATUS_COUNT);
+    f.led.setStatus(0, 0xffff);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+
+    // Entries with howLong are overrides of that duration and priority
+    f.led.setStatus(0, STATUS_BUTTON);
+    CHECK_EQUAL(f.pixel(0), WHITE);
+    f.led.setStatus(0, STATUS_ALERT);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.led.setStatus(0, STATUS_BUTTON);
+    CHECK_EQUAL(f.pixel(0), RED);
+    f.run(300);
+    CHECK_EQUAL(f.pixel(0), WHITE);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+
+    // ...and clearOnChange: setting the pixel removes the alert but not the button
+    f.led.setStatus(3, STATUS_ALERT);
+    f.led.setStatus(3, STATUS_OK);
+    CHECK_EQUAL(f.pixel(3), GREEN);
+    f.led.setStatus(4, STATUS_BUTTON);
+    f.led.setStatus(4, STATUS_OK);
+    CHECK_EQUAL(f.pixel(4), WHITE);
+    f.run(500);
+    CHECK_EQUAL(f.pixel(4), GREEN);
+}
+
+static void testSnapshot() {
+    NeoFixture f(6), f2(6);
+    static uint8_t snap[StatusLedRK::snapshotSize(6, 4)];
+
+    f.led.setColorStyle(0, BLUE, StatusLedRK::STYLE_ON);
+    f.led.setColorStyle(1, GREEN, StatusLedRK::STYLE_BLINK_SLOW);
+    f.led.setColorStyle(5, 0x123456, StatusLedRK::STYLE_ON);
+    f.led.setOverrideStyle(3, WHITE, StatusLedRK::STYLE_ON, 5000, true, 0);
+    f.led.setOverrideStyle(3, RED, StatusLedRK::STYLE_ON, 2000, false, 5);
+    f.run(500);
+
+    CHECK(f.led.getSnapshotSize() <= sizeof(snap));
+    size_t size = f.led.saveSnapshot(snap, sizeof(snap));
+    CHECK_EQUAL(size, f.led.getSnapshotSize());
+    CHECK_EQUAL(f.led.saveSnapshot(snap, 10), 0);
+
+    CHECK(f2.led.restoreSnapshot(snap, size));
+    f2.run(0);
+    for(uint16_t ii = 0; ii < 6; ii++) {
+        CHECK_EQUAL(f2.pixel(ii), f.pixel(ii));
+    }
+
+    // Overrides keep the time they had left
+    f2.run(1500);
+    CHECK_EQUAL(f2.pixel(3), WHITE);
+    f2.run(3000);
+    CHECK_EQUAL(f2.pixel(3), 0);
+
+    // Rejected snapshots leave the LEDs unchanged
+    NeoFixture f3(6);
+    f3.led.setColorStyle(0, RED, StatusLedRK::STYLE_ON);
+    CHECK(!f3.led.restoreSnapshot(snap, 10));
+
+    uint8_t junk[sizeof(snap)];
+    memset(junk, 0xa5, sizeof(junk));
+    CHECK(!f3.led.restoreSnapshot(junk, sizeof(junk)));
+
+    snap[size - 1] ^= 1;
+    CHECK(!f3.led.restoreSnapshot(snap, size));
+
+    NeoFixture f7(7);
+    snap[size - 1] ^= 1;
+    CHECK(!f7.led.restoreSnapshot(snap, size));
+
+    f3.run(0);
+    CHECK_EQUAL(f3.pixel(0), RED);
+    CHECK_EQUAL(f3.pixel(1), 0);
+}
+
+static void testStreamDecoder() {
+    NeoFixture f(10);
+    Decoder dec(&f.led);
+    HostMemoryStream stream;
+
+    std::vector<uint8_t> frame = {
+        0x11, // Garbage before the frame is skipped
+        Decoder::FRAME_START,
+        Decoder::CMD_FILL, 0,0, 10,0, 0x10,0x20,0x30, StatusLedRK::STYLE_ON,
+        Decoder::CMD_RUNS, 2,0, 0, 2, 3, 0xff,0,0, 2, 0,0xff,0,
+        Decoder::CMD_OVERRIDE, 9,0, 1,2,3, StatusLedRK::STYLE_ON, 0xe8,0x03,0,0, 1, 1,
+        Decoder::CMD_END
+    };
+
+    // A frame split across calls is shown once, when it's complete
+    f.strip.resetCounters();
+    stream.write(frame.data(), 10);
+    CHECK_EQUAL(dec.process(stream), 0);
+    CHECK_EQUAL(f.strip.showCount, 0);
+    CHECK_EQUAL(f.pixel(0), 0);
+
+    stream.write(frame.data() + 10, frame.size() - 10);
+    CHECK_EQUAL(dec.process(stream), 1);
+    CHECK_EQUAL(f.strip.showCount, 1);
+    CHECK_EQUAL(dec.getFrameCount(), 1);
+
+    CHECK_EQUAL(f.pixel(0), 0x102030);
+    CHECK_EQUAL(f.pixel(1), 0x102030);
+    CHECK_EQUAL(f.pixel(2), 0xff0000);
+    CHECK_EQUAL(f.pixel(4), 0xff0000);
+    CHECK_EQUAL(f.pixel(5), 0x00ff00);
+    CHECK_EQUAL(f.pixel(6), 0x00ff00);
+    CHECK_EQUAL(f.pixel(7), 0x102030);
+    CHECK_EQUAL(f.pixel(9), 0x010203);
+
+    f.run(1000);
+    CHECK_EQUAL(f.pixel(9), 0x102030);
+
+    // An unknown command drops the frame, and the next frame is still decoded
+    uint32_t errors = dec.getErrorCount();
+    std::vector<uint8_t> frames = {
+        Decoder::FRAME_START, 0x42,
+        Decoder::FRAME_START, Decoder::CMD_FILL, 1,0, 1,0, 2,2,2, StatusLedRK::STYLE_ON, Decoder::CMD_END
+    };
+    stream.write(frames.data(), frames.size());
+    CHECK_EQUAL(dec.process(stream), 1);
+    CHECK_EQUAL(dec.getErrorCount(), errors + 1);
+    CHECK_EQUAL(f.pixel(0), 0x102030);
+    CHECK_EQUAL(f.pixel(1), 0x020202);
+}
+
+static void testStreamOutOfRange() {
+    NeoFixture f(10);
+    Decoder dec(&f.led);
+    HostMemoryStream stream;
+
+    // Pixel numbers past the end of the strip are ignored, and never wrap around to pixel 0
+    std::vector<uint8_t> frame = {
+        Decoder::FRAME_START,
+        Decoder::CMD_FILL, 0,0, 10,0, 0,0x80,0, StatusLedRK::STYLE_ON,
+        Decoder::CMD_FILL, 0xf0,0xff, 0x20,0, 0xff,0,0, StatusLedRK::STYLE_ON,
+        Decoder::CMD_RUNS, 0xfe,0xff, StatusLedRK::STYLE_ON, 1, 5, 0,0,0xff,
+        Decoder::CMD_STYLES, 0xfe,0xff, 4,0, 0xaa,
+        Decoder::CMD_RUNS, 8,0, StatusLedRK::STYLE_ON, 2, 5, 0xff,0xff,0xff, 1, 0xff,0,0,
+        Decoder::CMD_FILL, 9,0, 0xff,0xff, 0,0,0xff, StatusLedRK::STYLE_ON,
+        Decoder::CMD_END
+    };
+    stream.write(frame.data(), frame.size());
+    CHECK_EQUAL(dec.process(stream), 1);
+    CHECK_EQUAL(dec.getErrorCount(), 0);
+
+    for(uint16_t ii = 0; ii < 8; ii++) {
+        CHECK_EQUAL(f.pixel(ii), GREEN);
+    }
+    CHECK_EQUAL(f.pixel(8), WHITE);
+    CHECK_EQUAL(f.pixel(9), BLUE);
+
+    // The styles past the end didn't make pixels 0 and 1 blink
+    f.run(250);
+    CHECK_EQUAL(f.pixel(0), GREEN);
+    CHECK_EQUAL(f.pixel(1), GREEN);
+}
+
+static void testStreamBadStyle() {
+    Adafruit_NeoPixel strip(8, 0, WS2812B);
+    InspectNeopixel led(&strip);
+    StatusLedRK_ManualClock clock(1000);
+    led.setClock(&clock);
+    led.setup();
+    Decoder dec(&led);
+    HostMemoryStream stream;
+
+    std::vector<uint8_t> frames = {
+        // Style 4 does not exist, so the frame ends before anything is set
+        Decoder::FRAME_START, Decoder::CMD_FILL, 0,0, 8,0, 0x10,0x20,0x30, 4, Decoder::CMD_END,
+        Decoder::FRAME_START, Decoder::CMD_RUNS, 0,0, 0xff, 1, 2, 0xff,0,0, Decoder::CMD_END,
+        // Patterns can't be sent
+        Decoder::FRAME_START, Decoder::CMD_OVERRIDE, 1,0, 1,2,3, StatusLedRK::STYLE_PATTERN, 0xe8,0x03,0,0, 1, 0, Decoder::CMD_END,
+        // Pixel 0 is set to STYLE_BLINK_FAST, then pixel 1 is STYLE_PATTERN
+        Decoder::FRAME_START, Decoder::CMD_STYLES, 0,0, 4,0, 0x0e, Decoder::CMD_END,
+        // A good frame after the bad ones is decoded
+        Decoder::FRAME_START, Decoder::CMD_FILL, 4,0, 2,0, 0x40,0x50,0x60, StatusLedRK::STYLE_ON, Decoder::CMD_END
+    };
+    stream.write(frames.data(), frames.size());
+    CHECK_EQUAL(dec.process(stream), 1);
+    CHECK_EQUAL(dec.getErrorCount(), 4);
+    CHECK_EQUAL(dec.getFrameCount(), 1);
+
+    CHECK_EQUAL(strip.getPixelColor(1), 0);
+    CHECK_EQUAL(strip.getPixelColor(2), 0);
+    CHECK_EQUAL(led.getColorWithOverride(1), 0);
+    CHECK_EQUAL(strip.getPixelColor(4), 0x405060);
+    CHECK_EQUAL(strip.getPixelColor(5), 0x405060);
+    CHECK_EQUAL(led.getBlinkingCount(), 1);
+    CHECK(led.getLoopCheckEnabled());
+
+    // Turning every pixel back on stops the loop check
+    std::vector<uint8_t> solid = {
+        Decoder::FRAME_START, Decoder::CMD_FILL, 0,0, 8,0, 0,0,0xff, StatusLedRK::STYLE_ON, Decoder::CMD_END
+    };
+    stream.write(solid.data(), solid.size());
+    CHECK_EQUAL(dec.process(stream), 1);
+    CHECK_EQUAL(led.getBlinkingCount(), 0);
+    CHECK(!led.getLoopCheckEnabled());
+
+    // Invalid styles from the API are treated as STYLE_ON
+    led.setColorStyle(0, RED, StatusLedRK::STYLE_BLINK_SLOW);
+    led.setColorStyle(0, RED, 9);
+    led.setColorStyle(1, RED, StatusLedRK::STYLE_PATTERN);
+    led.setOverrideStyle(2, RED, 200, 1000);
+    CHECK_EQUAL(led.getBlinkingCount(), 0);
+    clock.advance(1000);
+    led.loop();
+    CHECK_EQUAL(strip.getPixelColor(0), RED);
+    CHECK_EQUAL(strip.getPixelColor(1), RED);
+    CHECK(!led.getLoopCheckEnabled());
+}
+
+static void testSystemMirror() {
+    Adafruit_NeoPixel strip(4, 0, WS2812B);
+    StatusLedRK_Neopixel led(&strip);
+    HostMock::setMillis(1000);
+    led.setup();
+
+    led.setColorStyle(0, GREEN, StatusLedRK::STYLE_ON);
+    led.startSystemMirror(2);
+    RGB.mockChange(0, 10, 20);
+    RGB.mockChange(0, 30, 40);
+
+    // The change is applied from loop(), only the latest color is shown
+    CHECK_EQUAL(strip.getPixelColor(2), 0);
+    strip.resetCounters();
+    led.loop();
+    CHECK_EQUAL(strip.getPixelColor(2), 0x001e28);
+    CHECK_EQUAL(strip.getPixelColor(0), GREEN);
+    CHECK_EQUAL(strip.showCount, 1);
+
+    led.loop();
+    CHECK_EQUAL(strip.showCount, 1);
+
+    // The same color again doesn't show anything
+    RGB.mockChange(0, 30, 40);
+    led.loop();
+    CHECK_EQUAL(strip.showCount, 1);
+
+    // Overrides of the mirror pixel stay in effect, even with clearOnChange
+    led.setOverrideStyle(2, RED, StatusLedRK::STYLE_ON, 1000, true);
+    CHECK_EQUAL(strip.getPixelColor(2), RED);
+    RGB.mockChange(50, 60, 70);
+    led.loop();
+    CHECK_EQUAL(strip.getPixelColor(2), RED);
+    HostMock::advanceMillis(1000);
+    led.loop();
+    CHECK_EQUAL(strip.getPixelColor(2), 0x323c46);
+
+    led.stopSystemMirror();
+    RGB.mockChange(1, 2, 3);
+    led.loop();
+    CHECK_EQUAL(strip.getPixelColor(2), 0x323c46);
+}
+
+static void testSystemMirrorThread() {
+    Adafruit_NeoPixel strip(4, 0, WS2812B);
+    StatusLedRK_Neopixel led(&strip);
+    HostMock::setMillis(1000);
+    led.setup();
+
+    // The current system LED color is shown right away, without waiting for a change
+    RGB.mockChange(0, 0x40, 0x40);
+    led.startSystemMirror(1);
+    CHECK_EQUAL(strip.getPixelColor(1), 0x004040);
+
+    // The worker thread has nothing scheduled, so only the change handler can wake it
+    led.setPatternFrameMs(60000);
+    led.startThread();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    RGB.mockChange(0x40, 0, 0);
+    bool shown = false;
+    for(size_t ii = 0; ii < 1000 && !shown; ii++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        WITH_LOCK(led) {
+            shown = (strip.getPixelColor(1) == 0x400000);
+        }
+    }
+    CHECK(shown);
+
+    led.stopSystemMirror();
+    led.stopThread();
+}
+
+static void testCompositeOutputs() {
+    Adafruit_NeoPixel stripA(8, 0, WS2812B);
+    Adafruit_NeoPixel stripB(8, 1, WS2812B);
+    Adafruit_NeoPixel stripC(2, 2, WS2812B);
+    StatusLedRK_Neopixel outputA(&stripA);
+    StatusLedRK_Neopixel outputB(&stripB);
+    StatusLedRK_Neopixel outputC(&stripC);
+    StatusLedRK_ManualClock clock(1000);
+
+    // Output B is reversed and doesn't show logical pixel 1, output C only shows logical pixel 3
+    static const uint16_t mapB[4] = { 7, StatusLedRK_Composite::NO_PIXEL, 3, 1 };
+    StatusLedRK_Composite composite(4);
+    composite.setClock(&clock);
+    CHECK(composite.addOutput(&outputA, 0, 4));
+    CHECK(composite.addOutputMap(&outputB, mapB, 4));
+    CHECK(composite.addOutput(&outputC, 3, 1, 1));
+    composite.setup();
+
+    // One logical pixel is mirrored on both outputs that display it
+    composite.setColorStyle(0, RED, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(stripA.getPixelColor(0), RED);
+    CHECK_EQUAL(stripB.getPixelColor(7), RED);
+
+    // Pixels reach an output in logical pixel order, which the map can reverse
+    composite.beginUpdate();
+    composite.setColorStyle(2, BLUE, StatusLedRK::STYLE_ON);
+    composite.setColorStyle(3, GREEN, StatusLedRK::STYLE_ON);
+    composite.commit();
+    CHECK_EQUAL(stripA.getPixelColor(2), BLUE);
+    CHECK_EQUAL(stripA.getPixelColor(3), GREEN);
+    CHECK_EQUAL(stripB.getPixelColor(3), BLUE);
+    CHECK_EQUAL(stripB.getPixelColor(1), GREEN);
+    CHECK_EQUAL(stripC.getPixelColor(1), GREEN);
+    CHECK_EQUAL(stripC.getPixelColor(0), 0);
+
+    // showComplete() only goes to the outputs that were written
+    stripA.resetCounters();
+    stripB.resetCounters();
+    stripC.resetCounters();
+    composite.setColorStyle(1, WHITE, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(stripA.getPixelColor(1), WHITE);
+    CHECK_EQUAL(stripA.showCount, 1);
+    CHECK_EQUAL(stripB.showCount, 0);
+    CHECK_EQUAL(stripC.showCount, 0);
+
+    composite.setColorStyle(3, RED, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(stripA.showCount, 2);
+    CHECK_EQUAL(stripB.showCount, 1);
+    CHECK_EQUAL(stripC.showCount, 1);
+    CHECK_EQUAL(stripC.getPixelColor(1), RED);
+}
+
+static void testCompositeSegments() {
+    Adafruit_NeoPixel strip(40, 0, WS2812B);
+    StatusLedRK_Neopixel output(&strip);
+    StatusLedRK_ManualClock clock(1000);
+
+    // Groups mixed with single pixels. Logical pixel 3 isn't displayed and 4 is clipped to the strip.
+    static const StatusLedRK_Composite::Segment segments[5] = { {0, 1}, {1, 30}, {31, 1}, {32, 0}, {35, 10} };
+    StatusLedRK_Composite composite(5);
+    composite.setClock(&clock);
+    CHECK(composite.addOutputSegments(&output, segments, 5));
+    composite.setup();
+
+    composite.beginUpdate();
+    composite.setColorStyle(0, RED, StatusLedRK::STYLE_ON);
+    composite.setColorStyle(1, GREEN, StatusLedRK::STYLE_BLINK_FAST);
+    composite.setColorStyle(2, BLUE, StatusLedRK::STYLE_ON);
+    composite.setColorStyle(3, WHITE, StatusLedRK::STYLE_ON);
+    composite.setColorStyle(4, RED, StatusLedRK::STYLE_ON);
+    composite.commit();
+    composite.loop();
+
+    // Every member pixel of a group gets its color, including more than one batch of 32
+    CHECK_EQUAL(strip.getPixelColor(0), RED);
+    for(uint16_t ii = 1; ii <= 30; ii++) {
+        CHECK_EQUAL(strip.getPixelColor(ii), GREEN);
+    }
+    CHECK_EQUAL(strip.getPixelColor(31), BLUE);
+    for(uint16_t ii = 32; ii < 35; ii++) {
+        CHECK_EQUAL(strip.getPixelColor(ii), 0);
+    }
+    for(uint16_t ii = 35; ii < 40; ii++) {
+        CHECK_EQUAL(strip.getPixelColor(ii), RED);
+    }
+
+    // The whole group blinks together, and only the group changes
+    strip.resetCounters();
+    clock.advance(250);
+    composite.loop();
+    CHECK_EQUAL(strip.showCount, 1);
+    for(uint16_t ii = 1; ii <= 30; ii++) {
+        CHECK_EQUAL(strip.getPixelColor(ii), 0);
+    }
+    CHECK_EQUAL(strip.getPixelColor(0), RED);
+    CHECK_EQUAL(strip.getPixelColor(31), BLUE);
+
+    // A single pixel range next to a group is set by itself
+    composite.setColorStyle(2, WHITE, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(strip.getPixelColor(31), WHITE);
+    CHECK_EQUAL(strip.getPixelColor(30), 0);
+    CHECK_EQUAL(strip.getPixelColor(32), 0);
+}
+
+static void testStaticStorage() {
+    Adafruit_NeoPixel strip(4, 0, WS2812B), strip2(4, 0, WS2812B);
+    StatusLedRK_Static<StatusLedRK_Neopixel, 4> led(&strip);
+    StatusLedRK_Static<StatusLedRK_Neopixel, 4, 2, 0, true> led2(&strip2);
+    StatusLedRK_ManualClock clock(1000);
+    led.setClock(&clock);
+    led2.setClock(&clock);
+    led.setup();
+    led2.setup();
+
+    // Without OUTPUT_CORRECTION brightness is ignored rather than allocated
+    led.setBrightness(128);
+    led.setPixelBrightness(1, 0);
+    led.fill(RED);
+    CHECK_EQUAL(strip.getPixelColor(0), RED);
+    CHECK_EQUAL(strip.getPixelColor(1), RED);
+    CHECK_EQUAL(led.getMemoryUsage(), 0);
+
+    led2.setBrightness(128);
+    led2.setPixelBrightness(1, 0);
+    led2.fill(RED);
+    CHECK_EQUAL(strip2.getPixelColor(0), 0x800000);
+    CHECK_EQUAL(strip2.getPixelColor(1), 0);
+
+    // Overrides past MAX_OVERRIDES and patterns past MAX_PATTERNS are ignored
+    for(uint16_t ii = 0; ii < 4; ii++) {
+        led2.setOverrideStyle(ii, BLUE, StatusLedRK::STYLE_ON, 1000);
+    }
+    led2.setColorPattern(3, GREEN, &StatusLedRK::PATTERN_BREATHE);
+    CHECK_EQUAL(strip2.getPixelColor(0), 0x000080);
+    CHECK_EQUAL(strip2.getPixelColor(2), 0x800000);
+    CHECK_EQUAL(strip2.getPixelColor(3), 0x004000);
+}
+
+static void testDestroyWithThread() {
+    // Simulated time runs in the background so the worker thread is always busy
+    std::atomic<bool> ticking(true);
+    std::thread ticker([&ticking]() {
+        while(ticking) {
+            HostMock::advanceMillis(10);
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    });
+
+    std::vector<StatusLedRK_RGB::LedPins> pins(256);
+    for(size_t ii = 0; ii < pins.size(); ii++) {
+        pins[ii] = { (pin_t)(ii * 3), (pin_t)(ii * 3 + 1), (pin_t)(ii * 3 + 2) };
+    }
+
+    for(size_t iter = 0; iter < 50; iter++) {
+        StatusLedRK *led;
+        if (iter % 2) {
+            led = new StatusLedRK_RGB(pins.size(), pins.data(), true);
+        }
+        else {
+            led = new StatusLedRK_Static<StatusLedRK_RGB, 256, 8, 256>(pins.size(), pins.data(), true);
+        }
+        led->setup();
+        led->setPatternFrameMs(1);
+        for(uint16_t ii = 0; ii < pins.size(); ii++) {
+            led->setColorPattern(ii, (ii % 2) ? RED : BLUE, &StatusLedRK::PATTERN_BREATHE);
+        }
+        led->startThread();
+        delay(2);
+
+        // The subclass destructor stops the thread before its own members are destroyed
+        delete led;
+
+        uint32_t writes = HostMock::analogWriteCount;
+        delay(2);
+        CHECK_EQUAL(HostMock::analogWriteCount, writes);
+    }
+
+    ticking = false;
+    ticker.join();
+}
+
+static void testStartThreadInUpdate() {
+    NeoFixture f;
+    uint32_t unlockErrors = HostMock::mutexUnlockErrors;
+
+    // The outer beginUpdate() was before the mutex existed, so its commit() must not unlock it
+    f.led.beginUpdate();
+    f.led.startThread();
+    f.led.beginUpdate();
+    f.led.setColor(0, RED);
+    f.led.commit();
+    f.led.setColor(1, GREEN);
+    f.led.commit();
+    CHECK_EQUAL(HostMock::mutexUnlockErrors, unlockErrors);
+    CHECK_EQUAL(f.pixel(0), RED);
+    CHECK_EQUAL(f.pixel(1), GREEN);
+
+    // Still locked and unlocked in pairs afterwards
+    f.led.beginUpdate();
+    f.led.setColor(2, BLUE);
+    f.led.commit();
+    f.led.stopThread();
+    CHECK_EQUAL(HostMock::mutexUnlockErrors, unlockErrors);
+    CHECK_EQUAL(f.pixel(2), BLUE);
+}
+
+static void testPCA9531() {
+    PCA9531 chip;
+    StatusLedRK_PCA9531 led(&chip);
+    StatusLedRK_ManualClock clock(1000);
+    led.setClock(&clock);
+    chip.begin();
+    led.setup();
+
+    // Blink channels: slow limited to the longest period, fast is 500 ms, both 50% duty cycle
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_PSC0], 255);
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_PWM0], 128);
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_PSC1], 75);
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_PWM1], 128);
+
+    led.setColorStyle(0, RED, StatusLedRK::STYLE_ON);
+    led.setColorStyle(1, RED, StatusLedRK::STYLE_BLINK_SLOW);
+    led.setColorStyle(5, RED, StatusLedRK::STYLE_BLINK_FAST);
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_LS0], 0x09);
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_LS1], 0x0c);
+
+    CHECK(chip.isLit(0, 0));
+    CHECK(chip.isLit(0, 900));
+    CHECK(chip.isLit(1, 0));
+    CHECK(!chip.isLit(1, 900));
+    CHECK(chip.isLit(5, 0));
+    CHECK(!chip.isLit(5, 300));
+    CHECK(!chip.isLit(2, 0));
+
+    // The chip does the blinking, so loop() never writes to it
+    chip.resetCounters();
+    for(size_t ii = 0; ii < 100; ii++) {
+        clock.advance(100);
+        led.loop();
+    }
+    CHECK_EQUAL(chip.i2cTransactionCount, 0);
+
+    // Only the selector register that changed is written
+    led.setColorStyle(2, GREEN, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(chip.i2cTransactionCount, 1);
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_LS0], 0x19);
+
+    led.setOverrideStyle(5, BLUE, StatusLedRK::STYLE_ON, 1000);
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_LS1], 0x04);
+    clock.advance(1000);
+    led.loop();
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_LS1], 0x0c);
+
+    // As a composite output it's blinked in software, in sync with the other outputs
+    PCA9531 chip2;
+    StatusLedRK_PCA9531 output(&chip2);
+    StatusLedRK_Composite composite(PCA9531::MAX_LED);
+    composite.setClock(&clock);
+    composite.addOutput(&output, 0, PCA9531::MAX_LED);
+    composite.setup();
+
+    composite.setColorStyle(1, RED, StatusLedRK::STYLE_BLINK_FAST);
+    composite.loop();
+    CHECK_EQUAL(chip2.registers[StatusLedRK_PCA9531::REG_LS0], 0x04);
+    clock.advance(250);
+    composite.loop();
+    CHECK_EQUAL(chip2.registers[StatusLedRK_PCA9531::REG_LS0], 0x00);
+    clock.advance(250);
+    composite.loop();
+    CHECK_EQUAL(chip2.registers[StatusLedRK_PCA9531::REG_LS0], 0x04);
+}
+
+// Versions of the PCA9531 library without a public writeRegister() only have setLed() and updateLeds()
+struct PCA9531WithoutRegisters {
+    void setLed(uint16_t, uint32_t, bool = true) {}
+    void updateLeds() {}
+};
+static_assert(StatusLedRK_PCA9531_HasWriteRegister<PCA9531>::value, "writeRegister() not detected");
+static_assert(!StatusLedRK_PCA9531_HasWriteRegister<PCA9531WithoutRegisters>::value, "writeRegister() detected");
+
+static void testPCA9531SetLed() {
+    PCA9531 chip;
+    StatusLedRK_PCA9531 led(&chip, false);
+    StatusLedRK_ManualClock clock(1000);
+    led.setClock(&clock);
+    chip.begin();
+    led.setup();
+    CHECK(!led.getUseRegisters());
+
+    // Only setLed() and updateLeds() are used, so the blink channels are never set
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_PSC0], 0);
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_PWM0], 0);
+
+    chip.resetCounters();
+    led.setColorStyle(0, RED, StatusLedRK::STYLE_ON);
+    CHECK_EQUAL(chip.updateLedsCount, 1);
+    CHECK(chip.setLedCount >= 1);
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_LS0], 0x01);
+
+    // Blinking is done in software
+    led.setColorStyle(1, RED, StatusLedRK::STYLE_BLINK_FAST);
+    led.loop();
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_LS0], 0x05);
+    clock.advance(250);
+    led.loop();
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_LS0], 0x01);
+    clock.advance(250);
+    led.loop();
+    CHECK_EQUAL(chip.registers[StatusLedRK_PCA9531::REG_LS0], 0x05);
+
+    // The LEDs are on or off, so a dimmed color is fully on, with or without the registers
+    led.setBrightness(8);
+    led.setColorStyle(2, GREEN, StatusLedRK::STYLE_ON);
+    CHECK(chip.ledOn[2]);
+
+    PCA9531 chip2;
+    StatusLedRK_PCA9531 led2(&chip2);
+    led2.setClock(&clock);
+    led2.setup();
+    led2.setBrightness(8);
+    led2.setColorStyle(3, GREEN, StatusLedRK::STYLE_BLINK_SLOW);
+    CHECK_EQUAL(chip2.registers[StatusLedRK_PCA9531::REG_LS0], 0x80);
+    CHECK(chip2.isLit(3, 0));
+}
+
+static void testStaticNoHeap() {
+    static const StatusLedRK_RGB::LedPins pins[2] = { { 1, 2, 3 }, { 4, 5, 6 } };
+
+    uint32_t allocsBefore = allocCount;
+    {
+        StatusLedRK_Static<StatusLedRK_RGB, 2> led(2, pins, false);
+        StatusLedRK_ManualClock clock(1000);
+        led.setClock(&clock);
+        led.setup();
+        led.setColorStyle(0, RED, StatusLedRK::STYLE_BLINK_FAST);
+        led.setColorStyle(1, 0x204080, StatusLedRK::STYLE_ON);
+        led.setOverrideStyle(1, WHITE, StatusLedRK::STYLE_ON, 100);
+        for(size_t ii = 0; ii < 10; ii++) {
+            clock.advance(50);
+            led.loop();
+        }
+        CHECK_EQUAL(HostMock::pinValue[4], 0x20);
+        CHECK_EQUAL(HostMock::pinValue[5], 0x40);
+        CHECK_EQUAL(HostMock::pinValue[6], 0x80);
+
+        // The output cache still skips unchanged channels
+        HostMock::resetCounters();
+        led.setColorStyle(1, 0x204081, StatusLedRK::STYLE_ON);
+        CHECK_EQUAL(HostMock::analogWriteCount + HostMock::digitalWriteCount, 1);
+    }
+    CHECK_EQUAL(allocCount - allocsBefore, 0);
+}
+
+static void testSetupOutOfMemory() {
+    Adafruit_NeoPixel strip(100, 0, WS2812B);
+    StatusLedRK_Neopixel led(&strip);
+    StatusLedRK_ManualClock clock(1000);
+    led.setClock(&clock);
+
+    // The third array allocated by setup() fails, and the first two are freed
+    failAllocAfter = 2;
+    led.setup();
+    failAllocAfter = -1;
+    CHECK_EQUAL(led.getNumPixels(), 0);
+    CHECK_EQUAL(led.getMemoryUsage(), 0);
+
+    // Calls that use the pixels are ignored instead of using the missing arrays
+    led.setColorStyle(0, RED, StatusLedRK::STYLE_BLINK_FAST);
+    led.setColorPattern(1, GREEN, &StatusLedRK::PATTERN_BREATHE);
+    led.setOverrideStyle(2, WHITE, StatusLedRK::STYLE_ON, 1000);
+    led.setOverrideRange(0, 10, WHITE, StatusLedRK::STYLE_ON, 1000);
+    led.fill(BLUE);
+    led.setPixelBrightness(0, 10);
+    led.setBlinkSync(true);
+    clock.advance(1000);
+    led.loop();
+    led.showAll();
+    CHECK_EQUAL(led.getColorWithOverride(0), 0);
+    CHECK_EQUAL(led.getMillisUntilNextEvent(), StatusLedRK::NO_EVENT);
+    CHECK_EQUAL(strip.getPixelColor(0), 0);
+}
+
+typedef struct {
+    const char *name;
+    void (*fn)();
+} TestCase;
+
+static const TestCase tests[] = {
+    { "blinkPhase", testBlinkPhase },
+    { "blinkRestart", testBlinkRestart },
+    { "manualClock", testManualClock },
+    { "resync", testResync },
+    { "patternSteps", testPatternSteps },
+    { "patternEasing", testPatternEasing },
+    { "patternBuiltIn", testPatternBuiltIn },
+    { "patternFrameRate", testPatternFrameRate },
+    { "frameLimit", testFrameLimit },
+    { "brightnessGamma", testBrightnessGamma },
+    { "neopixelBuffer", testNeopixelBuffer },
+    { "overrideExpiry", testOverrideExpiry },
+    { "overrideLayers", testOverrideLayers },
+    { "statusTable", testStatusTable },
+    { "snapshot", testSnapshot },
+    { "streamDecoder", testStreamDecoder },
+    { "streamOutOfRange", testStreamOutOfRange },
+    { "streamBadStyle", testStreamBadStyle },
+    { "systemMirror", testSystemMirror },
+    { "systemMirrorThread", testSystemMirrorThread },
+    { "compositeOutputs", testCompositeOutputs },
+    { "compositeSegments", testCompositeSegments },
+    { "staticStorage", testStaticStorage },
+    { "staticNoHeap", testStaticNoHeap },
+    { "setupOutOfMemory", testSetupOutOfMemory },
+    { "pca9531", testPCA9531 },
+    { "pca9531SetLed", testPCA9531SetLed },
+    { "startThreadInUpdate", testStartThreadInUpdate },
+    { "destroyWithThread", testDestroyWithThread },
+};
+
+int main() {
+    for(size_t ii = 0; ii < sizeof(tests) / sizeof(tests[0]); ii++) {
+        currentTest = tests[ii].name;
+        int failsBefore = failCount;
+        tests[ii].fn();
+        printf("%-20s %s\n", currentTest, (failCount == failsBefore) ? "ok" : "FAILED");
+    }
+    printf("%d checks, %d failed\n", checkCount, failCount);
+
+    return (failCount == 0) ? 0 : 1;
+}